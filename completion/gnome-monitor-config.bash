@@ -0,0 +1,82 @@
+# bash completion for gnome-monitor-config
+#
+# Connectors and mode ids come from 'gnome-monitor-config __complete', which
+# answers from a cache instead of asking the compositor.
+
+_gnome_monitor_config_connector ()
+{
+  # Monitor given with the last -M before the word being completed
+  local i connector=
+  for ((i = 1; i < ${#words[@]} - 1; i++)); do
+    case ${words[i]} in
+      --monitor=*) connector=${words[i]#--monitor=} ;;
+      --monitor|-M|-[!-]*M) connector=${words[i+1]} ;;
+    esac
+  done
+  # Drop the quotes of e.g. -M 'DEL:*'
+  connector=${connector#[\'\"]}
+  connector=${connector%[\'\"]}
+  printf '%s\n' "$connector"
+}
+
+_gnome_monitor_config ()
+{
+  local line=${COMP_LINE:0:COMP_POINT}
+  local -a words candidates
+  local cur prev option value prefix c breaks= i command_index=
+
+  # Split the line ourselves, as COMP_WORDS is also split at '=' and at the
+  # '@' of mode ids
+  read -ra words <<< "$line"
+  [[ -z $line || $line == *[[:space:]] ]] && words+=("")
+  cur=${words[-1]}
+  prev=${words[-2]}
+
+  case $cur in
+    --monitor=*|--mode=*)
+      option=${cur%%=*}
+      value=${cur#*=}
+      ;;
+    *)
+      option=$prev
+      value=$cur
+      ;;
+  esac
+
+  case $option in
+    --monitor|-M|-[!-]*M)
+      mapfile -t candidates < <("$1" __complete connectors 2>/dev/null)
+      ;;
+    --mode|-m|-[!-]*m)
+      mapfile -t candidates < <("$1" __complete modes \
+                                "$(_gnome_monitor_config_connector)" 2>/dev/null)
+      ;;
+    *)
+      for ((i = 1; i < ${#words[@]}; i++)); do
+        if [[ ${words[i]} != --* ]]; then
+          command_index=$i
+          break
+        fi
+      done
+      if [[ $command_index == $((${#words[@]} - 1)) ]]; then
+        candidates=(list set show power locate list-stored apply-stored
+                    preview-batch confirm watch)
+      else
+        return
+      fi
+      ;;
+  esac
+
+  mapfile -t COMPREPLY < <(compgen -W "${candidates[*]}" -- "$value")
+
+  # Readline only replaces the text after the last word break character
+  for c in @ : =; do
+    [[ $COMP_WORDBREAKS == *"$c"* ]] && breaks+=$c
+  done
+  if [[ -n $breaks ]]; then
+    prefix=${value%"${value##*[$breaks]}"}
+    COMPREPLY=("${COMPREPLY[@]#"$prefix"}")
+  fi
+}
+
+complete -F _gnome_monitor_config gnome-monitor-config
@@ -25,13 +25,100 @@
 
 #include "gmc-display-config.h"
 #include "gmc-dbus-display-config.h"
+#include "gmc-trace.h"
+
+#define DISPLAY_CONFIG_BUS_NAME "org.gnome.Mutter.DisplayConfig"
+#define DISPLAY_CONFIG_OBJECT_PATH "/org/gnome/Mutter/DisplayConfig"
+#define DISPLAY_CONFIG_INTERFACE "org.gnome.Mutter.DisplayConfig"
+
+#define DEFAULT_QUIET_PERIOD_MS 250
+#define DEFAULT_MAX_DELAY_MS 2000
+
+enum
+{
+  STATE_CHANGED,
+
+  N_SIGNALS
+};
+
+static guint signals[N_SIGNALS];
 
 struct _CcDisplayConfigManager
 {
   GObject parent;
+  CcDisplayConfigManagerFlags flags;
+  char *address;
+  GDBusConnection *connection;
   CcDbusDisplayConfig *proxy;
+  /* Where the signals of the proxy are emitted */
+  GMainContext *main_context;
+
+  /* MonitorsChanged coalescing, see on_monitors_changed() */
+  unsigned int quiet_period_ms;
+  unsigned int max_delay_ms;
+  int64_t burst_start_time;
+  unsigned int quiet_timeout_id;
+  GCancellable *fetch_cancellable;
+  gboolean changed_during_fetch;
+  gboolean has_settled_serial;
+  unsigned int settled_serial;
+  CcDisplayMonitorsChangedStats monitors_changed_stats;
+
+  /* See publish_current_state() */
+  CcDisplayState *current_state;
 };
 
+#define CURRENT_STATE_LOCK_BIT 0
+
+static CcDisplayState *
+get_current_state_locked (CcDisplayConfigManager *manager)
+{
+  return (CcDisplayState *) ((guintptr) g_atomic_pointer_get (&manager->current_state) &
+                             ~((guintptr) 1 << CURRENT_STATE_LOCK_BIT));
+}
+
+/*
+ * The current state pointer is guarded by a bit lock in its lowest bit,
+ * held only while swapping the pointer or taking a reference, so readers
+ * on any thread never wait for a state to be fetched or parsed. Takes
+ * ownership of @state.
+ */
+static void
+publish_current_state (CcDisplayConfigManager *manager,
+                       CcDisplayState *state)
+{
+  CcDisplayState *old_state;
+
+  g_pointer_bit_lock (&manager->current_state, CURRENT_STATE_LOCK_BIT);
+  old_state = get_current_state_locked (manager);
+  /* Keeps the lock bit set; it is cleared by the unlock */
+  g_atomic_pointer_set (&manager->current_state,
+                        (gpointer) ((guintptr) state |
+                                    ((guintptr) 1 << CURRENT_STATE_LOCK_BIT)));
+  g_pointer_bit_unlock (&manager->current_state, CURRENT_STATE_LOCK_BIT);
+
+  if (old_state)
+    cc_display_state_unref (old_state);
+}
+
+/*
+ * Returns a new reference to the most recently fetched state, or NULL if
+ * none was fetched yet. May be called from any thread.
+ */
+CcDisplayState *
+cc_display_config_manager_dup_current_state (CcDisplayConfigManager *manager)
+{
+  CcDisplayState *state;
+
+  g_pointer_bit_lock (&manager->current_state, CURRENT_STATE_LOCK_BIT);
+  state = get_current_state_locked (manager);
+  if (state)
+    cc_display_state_ref (state);
+  g_pointer_bit_unlock (&manager->current_state, CURRENT_STATE_LOCK_BIT);
+
+  return state;
+}
+
 static void
 cc_display_config_manager_initable_init_iface (GInitableIface *iface);
 
@@ -40,11 +127,50 @@ G_DEFINE_TYPE_WITH_CODE (CcDisplayConfigManager, cc_display_config_manager,
                          G_IMPLEMENT_INTERFACE (G_TYPE_INITABLE,
                                                 cc_display_config_manager_initable_init_iface));
 
+GVariant *
+cc_display_config_manager_get_current_state_variant (CcDisplayConfigManager *manager,
+                                                     GError **error)
+{
+  GVariant *state_variant;
+  GMC_TRACE_BEGIN (get_current_state);
+
+  state_variant = g_dbus_connection_call_sync (manager->connection,
+                                               DISPLAY_CONFIG_BUS_NAME,
+                                               DISPLAY_CONFIG_OBJECT_PATH,
+                                               DISPLAY_CONFIG_INTERFACE,
+                                               "GetCurrentState",
+                                               NULL,
+                                               G_VARIANT_TYPE (CC_DISPLAY_STATE_FORMAT),
+                                               G_DBUS_CALL_FLAGS_NONE,
+                                               -1,
+                                               NULL,
+                                               error);
+
+  GMC_TRACE_END (get_current_state,
+                 0, 0, state_variant ? g_variant_get_size (state_variant) : 0);
+
+  return state_variant;
+}
+
 CcDisplayState *
 cc_display_config_manager_new_current_state (CcDisplayConfigManager *manager,
                                              GError **error)
 {
-  return cc_display_state_new_current (manager->proxy, error);
+  g_autoptr(GVariant) state_variant = NULL;
+  CcDisplayState *state;
+
+  state_variant =
+    cc_display_config_manager_get_current_state_variant (manager, error);
+  if (!state_variant)
+    return NULL;
+
+  state = cc_display_state_new_from_variant (state_variant, error);
+  if (!state)
+    return NULL;
+
+  publish_current_state (manager, cc_display_state_ref (state));
+
+  return state;
 }
 
 #define MONITOR_CONFIG_FORMAT "(ssa{sv})"
@@ -59,7 +185,7 @@ find_nearest_scale (CcDisplayMonitor *monitor,
                     CcDisplayMode *mode,
                     double configured_scale)
 {
-  double *supported_scales;
+  g_autofree double *supported_scales = NULL;
   int n_supported_scales;
   int i;
   double closest_scale = 0.0;
@@ -91,6 +217,9 @@ create_monitors_config_variant (CcDisplayState *state,
   GVariantBuilder config_builder;
   GList *logical_monitor_configs;
   GList *l;
+  GVariant *config_variant;
+  unsigned int n_monitors = 0;
+  GMC_TRACE_BEGIN (create_monitors_config_variant);
 
   g_variant_builder_init (&config_builder, G_VARIANT_TYPE (CONFIG_FORMAT));
 
@@ -138,6 +267,7 @@ create_monitors_config_variant (CcDisplayState *state,
                                  connector,
                                  mode_id,
                                  NULL);
+          n_monitors++;
         }
 
       cc_display_logical_monitor_config_get_position (logical_monitor_config,
@@ -156,7 +286,99 @@ create_monitors_config_variant (CcDisplayState *state,
                              &monitor_configs_builder);
     }
 
-  return g_variant_builder_end (&config_builder);
+  config_variant = g_variant_builder_end (&config_builder);
+
+  GMC_TRACE_END (create_monitors_config_variant,
+                 n_monitors, n_monitors, g_variant_get_size (config_variant));
+
+  return config_variant;
+}
+
+static GVariant *
+create_properties_variant (gboolean has_layout_mode,
+                           CcDisplayLayoutMode layout_mode)
+{
+  GVariantBuilder properties_builder;
+
+  g_variant_builder_init (&properties_builder, G_VARIANT_TYPE ("a{sv}"));
+  if (has_layout_mode)
+    {
+      g_variant_builder_add (&properties_builder,
+                             "{sv}", "layout-mode",
+                             g_variant_new_uint32 (layout_mode));
+    }
+
+  return g_variant_builder_end (&properties_builder);
+}
+
+/*
+ * Number of monitors configured in @logical_monitor_configs_variant, which is
+ * also the number of modes as each monitor gets one. Only used for tracing.
+ */
+static G_GNUC_UNUSED unsigned int
+count_configured_monitors (GVariant *logical_monitor_configs_variant)
+{
+  unsigned int n_monitors = 0;
+  gsize i;
+
+  for (i = 0; i < g_variant_n_children (logical_monitor_configs_variant); i++)
+    {
+      g_autoptr(GVariant) logical_monitor_config_variant = NULL;
+      g_autoptr(GVariant) monitor_configs_variant = NULL;
+
+      logical_monitor_config_variant =
+        g_variant_get_child_value (logical_monitor_configs_variant, i);
+      monitor_configs_variant =
+        g_variant_get_child_value (logical_monitor_config_variant, 5);
+      n_monitors += g_variant_n_children (monitor_configs_variant);
+    }
+
+  return n_monitors;
+}
+
+static gboolean
+apply_monitors_config_variant (CcDisplayConfigManager *manager,
+                               unsigned int serial,
+                               CcDisplayConfigMethod method,
+                               GVariant *logical_monitor_configs_variant,
+                               GVariant *properties_variant,
+                               GError **error)
+{
+  g_autoptr(GVariant) reply = NULL;
+  GMC_TRACE_BEGIN (apply);
+
+  if (gmc_debug_enabled ())
+    {
+      g_autofree char *logical_monitor_configs_string = NULL;
+
+      logical_monitor_configs_string =
+        g_variant_print (logical_monitor_configs_variant, TRUE);
+      g_debug ("Applying logical monitors %s with method %d",
+               logical_monitor_configs_string, method);
+    }
+
+  reply = g_dbus_connection_call_sync (manager->connection,
+                                       DISPLAY_CONFIG_BUS_NAME,
+                                       DISPLAY_CONFIG_OBJECT_PATH,
+                                       DISPLAY_CONFIG_INTERFACE,
+                                       "ApplyMonitorsConfig",
+                                       g_variant_new ("(uu@" CONFIG_FORMAT "@a{sv})",
+                                                      serial,
+                                                      method,
+                                                      logical_monitor_configs_variant,
+                                                      properties_variant),
+                                       NULL,
+                                       G_DBUS_CALL_FLAGS_NONE,
+                                       -1,
+                                       NULL,
+                                       error);
+
+  GMC_TRACE_END (apply,
+                 count_configured_monitors (logical_monitor_configs_variant),
+                 count_configured_monitors (logical_monitor_configs_variant),
+                 g_variant_get_size (logical_monitor_configs_variant));
+
+  return reply != NULL;
 }
 
 gboolean
@@ -166,69 +388,674 @@ cc_display_config_manager_apply (CcDisplayConfigManager *manager,
                                  CcDisplayConfigMethod method,
                                  GError **error)
 {
-  CcDbusDisplayConfig *proxy = manager->proxy;
-  unsigned int serial;
-  GVariant *logical_monitor_configs_variant;
-  GVariantBuilder properties_builder;
+  g_autoptr(GVariant) logical_monitor_configs_variant = NULL;
+  g_autoptr(GVariant) properties_variant = NULL;
   CcDisplayLayoutMode layout_mode;
+  gboolean has_layout_mode;
 
-  serial = cc_display_state_get_serial (state);
   logical_monitor_configs_variant =
-    create_monitors_config_variant (state, config);
+    g_variant_ref_sink (create_monitors_config_variant (state, config));
+  has_layout_mode = cc_display_config_get_layout_mode (config, &layout_mode);
+  properties_variant =
+    g_variant_ref_sink (create_properties_variant (has_layout_mode,
+                                                   layout_mode));
 
-  g_variant_builder_init (&properties_builder, G_VARIANT_TYPE ("a{sv}"));
-  if (cc_display_config_get_layout_mode (config, &layout_mode))
+  return apply_monitors_config_variant (manager,
+                                        cc_display_state_get_serial (state),
+                                        method,
+                                        logical_monitor_configs_variant,
+                                        properties_variant,
+                                        error);
+}
+
+struct _CcDisplayConfigSnapshot
+{
+  GVariant *logical_monitor_configs_variant;
+  GVariant *properties_variant;
+};
+
+/*
+ * Captures the configuration in effect in @state in the form it is sent to
+ * the compositor, so restoring it later only needs the then current serial.
+ */
+CcDisplayConfigSnapshot *
+cc_display_config_snapshot_new (CcDisplayState *state)
+{
+  g_autoptr(CcDisplayConfig) config = NULL;
+  CcDisplayConfigSnapshot *snapshot;
+
+  config = cc_display_config_new_from_state (state);
+
+  snapshot = g_new0 (CcDisplayConfigSnapshot, 1);
+  snapshot->logical_monitor_configs_variant =
+    g_variant_ref_sink (create_monitors_config_variant (state, config));
+  snapshot->properties_variant =
+    g_variant_ref_sink (create_properties_variant (cc_display_state_supports_changing_layout_mode (state),
+                                                   cc_display_state_get_layout_mode (state)));
+
+  return snapshot;
+}
+
+void
+cc_display_config_snapshot_free (CcDisplayConfigSnapshot *snapshot)
+{
+  g_variant_unref (snapshot->logical_monitor_configs_variant);
+  g_variant_unref (snapshot->properties_variant);
+  g_free (snapshot);
+}
+
+/*
+ * Applies @snapshot temporarily. Only the serial of the current state is
+ * read, the state itself is not parsed.
+ */
+gboolean
+cc_display_config_manager_restore_snapshot (CcDisplayConfigManager *manager,
+                                            CcDisplayConfigSnapshot *snapshot,
+                                            GError **error)
+{
+  g_autoptr(GVariant) state_variant = NULL;
+  unsigned int serial;
+
+  state_variant =
+    cc_display_config_manager_get_current_state_variant (manager, error);
+  if (!state_variant)
+    return FALSE;
+
+  g_variant_get_child (state_variant, 0, "u", &serial);
+
+  return apply_monitors_config_variant (manager,
+                                        serial,
+                                        CC_DISPLAY_METHOD_TEMPORARY,
+                                        snapshot->logical_monitor_configs_variant,
+                                        snapshot->properties_variant,
+                                        error);
+}
+
+/*
+ * Applies the steps of @transition in order. Intermediate steps are always
+ * temporary; only the last one uses @method. When merely verifying, only the
+ * final configuration is sent.
+ *
+ * The number of steps the compositor accepted is returned in
+ * @n_applied_steps, also on failure: anything but 0 means the monitors may
+ * have been left in an intermediate configuration.
+ */
+gboolean
+cc_display_config_manager_apply_transition_full (CcDisplayConfigManager *manager,
+                                                 CcDisplayState *state,
+                                                 CcDisplayTransition *transition,
+                                                 CcDisplayConfigMethod method,
+                                                 unsigned int *n_applied_steps,
+                                                 GError **error)
+{
+  unsigned int n_steps;
+  unsigned int i;
+
+  if (n_applied_steps)
+    *n_applied_steps = 0;
+
+  n_steps = cc_display_transition_get_n_steps (transition);
+  if (method == CC_DISPLAY_METHOD_VERIFY)
     {
-      g_variant_builder_add (&properties_builder,
-                             "{sv}", "layout-mode",
-                             g_variant_new_uint32 (layout_mode));
+      return cc_display_config_manager_apply (manager,
+                                              state,
+                                              cc_display_transition_get_step_config (transition,
+                                                                                     n_steps - 1),
+                                              method,
+                                              error);
+    }
+
+  for (i = 0; i < n_steps; i++)
+    {
+      g_autoptr(CcDisplayState) step_state = NULL;
+      CcDisplayConfigMethod step_method;
+
+      /* Every applied step invalidates the serial of the previous state. */
+      if (i > 0)
+        {
+          step_state = cc_display_config_manager_new_current_state (manager,
+                                                                    error);
+          if (!step_state)
+            return FALSE;
+        }
+
+      step_method = i == n_steps - 1 ? method : CC_DISPLAY_METHOD_TEMPORARY;
+      if (!cc_display_config_manager_apply (manager,
+                                            step_state ? step_state : state,
+                                            cc_display_transition_get_step_config (transition,
+                                                                                   i),
+                                            step_method,
+                                            error))
+        return FALSE;
+
+      if (n_applied_steps)
+        *n_applied_steps = i + 1;
+    }
+
+  return TRUE;
+}
+
+gboolean
+cc_display_config_manager_apply_transition (CcDisplayConfigManager *manager,
+                                            CcDisplayState *state,
+                                            CcDisplayTransition *transition,
+                                            CcDisplayConfigMethod method,
+                                            GError **error)
+{
+  return cc_display_config_manager_apply_transition_full (manager,
+                                                          state,
+                                                          transition,
+                                                          method,
+                                                          NULL,
+                                                          error);
+}
+
+CcDisplayPowerSaveMode
+cc_display_config_manager_get_power_save_mode (CcDisplayConfigManager *manager)
+{
+  g_autoptr(GVariant) mode_variant = NULL;
+
+  g_return_val_if_fail (manager->proxy, CC_DISPLAY_POWER_SAVE_MODE_UNKNOWN);
+
+  /*
+   * Not cached if the compositor doesn't have the property or isn't running,
+   * and then the generated getter would return 0, i.e. on.
+   */
+  mode_variant = g_dbus_proxy_get_cached_property (G_DBUS_PROXY (manager->proxy),
+                                                   "PowerSaveMode");
+  if (!mode_variant)
+    return CC_DISPLAY_POWER_SAVE_MODE_UNKNOWN;
+
+  return g_variant_get_int32 (mode_variant);
+}
+
+#define POWER_SAVE_MODE_CONFIRM_TIMEOUT_MS 5000
+
+typedef struct _PowerSaveModeChange
+{
+  CcDisplayPowerSaveMode mode;
+  gboolean confirmed;
+  gboolean timed_out;
+  int64_t confirm_time;
+} PowerSaveModeChange;
+
+static void
+on_power_save_mode_changed (CcDbusDisplayConfig *proxy,
+                            GParamSpec *pspec,
+                            PowerSaveModeChange *change)
+{
+  if (cc_dbus_display_config_get_power_save_mode (proxy) != change->mode)
+    return;
+
+  change->confirm_time = g_get_monotonic_time ();
+  change->confirmed = TRUE;
+}
+
+static gboolean
+on_power_save_mode_timeout (gpointer user_data)
+{
+  PowerSaveModeChange *change = user_data;
+
+  change->timed_out = TRUE;
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Sets PowerSaveMode and waits until the compositor confirms the new value
+ * through PropertiesChanged. The time between issuing the Set call and the
+ * confirmation is returned in @latency_us.
+ */
+gboolean
+cc_display_config_manager_set_power_save_mode (CcDisplayConfigManager *manager,
+                                               CcDisplayPowerSaveMode mode,
+                                               int64_t *latency_us,
+                                               GError **error)
+{
+  GDBusProxy *proxy;
+  PowerSaveModeChange change = { .mode = mode };
+  g_autoptr(GVariant) reply = NULL;
+  g_autoptr(GSource) timeout_source = NULL;
+  CcDisplayPowerSaveMode current_mode;
+  int64_t start_time;
+  gulong handler_id;
+
+  g_return_val_if_fail (manager->proxy, FALSE);
+
+  proxy = G_DBUS_PROXY (manager->proxy);
+  current_mode = cc_display_config_manager_get_power_save_mode (manager);
+  if (current_mode == CC_DISPLAY_POWER_SAVE_MODE_UNKNOWN)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                   "The compositor doesn't report a power save mode");
+      return FALSE;
+    }
+
+  if (current_mode == mode)
+    {
+      *latency_us = 0;
+      return TRUE;
+    }
+
+  handler_id = g_signal_connect (manager->proxy, "notify::power-save-mode",
+                                 G_CALLBACK (on_power_save_mode_changed),
+                                 &change);
+
+  start_time = g_get_monotonic_time ();
+  reply = g_dbus_connection_call_sync (g_dbus_proxy_get_connection (proxy),
+                                       g_dbus_proxy_get_name (proxy),
+                                       g_dbus_proxy_get_object_path (proxy),
+                                       "org.freedesktop.DBus.Properties",
+                                       "Set",
+                                       g_variant_new ("(ssv)",
+                                                      g_dbus_proxy_get_interface_name (proxy),
+                                                      "PowerSaveMode",
+                                                      g_variant_new_int32 (mode)),
+                                       NULL,
+                                       G_DBUS_CALL_FLAGS_NONE,
+                                       -1,
+                                       NULL,
+                                       error);
+  if (!reply)
+    {
+      g_signal_handler_disconnect (manager->proxy, handler_id);
+      return FALSE;
+    }
+
+  /* The confirmation arrives in the context the proxy was created in */
+  timeout_source = g_timeout_source_new (POWER_SAVE_MODE_CONFIRM_TIMEOUT_MS);
+  g_source_set_callback (timeout_source, on_power_save_mode_timeout,
+                         &change, NULL);
+  g_source_attach (timeout_source, manager->main_context);
+  while (!change.confirmed && !change.timed_out)
+    g_main_context_iteration (manager->main_context, TRUE);
+
+  g_source_destroy (timeout_source);
+  g_signal_handler_disconnect (manager->proxy, handler_id);
+
+  if (!change.confirmed)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                   "Power save mode change was not confirmed");
+      return FALSE;
+    }
+
+  *latency_us = change.confirm_time - start_time;
+
+  return TRUE;
+}
+
+static void schedule_settled_state_fetch (CcDisplayConfigManager *manager);
+
+static void
+on_settled_state_fetched (GObject *source_object,
+                          GAsyncResult *result,
+                          gpointer user_data)
+{
+  CcDisplayConfigManager *manager;
+  g_autoptr(GVariant) state_variant = NULL;
+  g_autoptr(GError) error = NULL;
+  CcDisplayState *state;
+  unsigned int serial;
+
+  state_variant = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object),
+                                                 result, &error);
+  if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    return;
+
+  manager = user_data;
+  g_clear_object (&manager->fetch_cancellable);
+
+  if (manager->changed_during_fetch)
+    {
+      int64_t elapsed_ms;
+
+      manager->changed_during_fetch = FALSE;
+
+      /* Whatever was fetched predates the latest change; keep waiting. */
+      elapsed_ms = (g_get_monotonic_time () - manager->burst_start_time) / 1000;
+      if (elapsed_ms < manager->max_delay_ms)
+        {
+          manager->monitors_changed_stats.n_stale_states++;
+          schedule_settled_state_fetch (manager);
+          return;
+        }
+
+      /*
+       * Unless the burst already outlasted the maximum delay, e.g. with an
+       * output that keeps flapping. Then report what was fetched, and treat
+       * the changes since as a new burst, so that fetches stay spaced out.
+       */
+      manager->burst_start_time = g_get_monotonic_time ();
+      schedule_settled_state_fetch (manager);
+    }
+  else
+    {
+      manager->burst_start_time = 0;
+    }
+
+  if (!state_variant)
+    {
+      g_warning ("Failed to get current display state: %s", error->message);
+      return;
     }
 
-  g_print ("%s\n", g_variant_print (logical_monitor_configs_variant, TRUE));
+  g_variant_get_child (state_variant, 0, "u", &serial);
+  if (manager->has_settled_serial && serial == manager->settled_serial)
+    {
+      manager->monitors_changed_stats.n_duplicates++;
+      return;
+    }
+
+  state = cc_display_state_new_from_variant (state_variant, &error);
+  if (!state)
+    {
+      g_warning ("Failed to parse display state: %s", error->message);
+      return;
+    }
+
+  publish_current_state (manager, cc_display_state_ref (state));
+  manager->settled_serial = serial;
+  manager->has_settled_serial = TRUE;
+  manager->monitors_changed_stats.n_settled++;
+
+  g_signal_emit (manager, signals[STATE_CHANGED], 0, state);
+  cc_display_state_unref (state);
+}
+
+static gboolean
+on_quiet_period_elapsed (gpointer user_data)
+{
+  CcDisplayConfigManager *manager = user_data;
+
+  manager->quiet_timeout_id = 0;
+  manager->fetch_cancellable = g_cancellable_new ();
+  g_dbus_connection_call (manager->connection,
+                          DISPLAY_CONFIG_BUS_NAME,
+                          DISPLAY_CONFIG_OBJECT_PATH,
+                          DISPLAY_CONFIG_INTERFACE,
+                          "GetCurrentState",
+                          NULL,
+                          G_VARIANT_TYPE (CC_DISPLAY_STATE_FORMAT),
+                          G_DBUS_CALL_FLAGS_NONE,
+                          -1,
+                          manager->fetch_cancellable,
+                          on_settled_state_fetched,
+                          manager);
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Fetches the state once no MonitorsChanged arrived for the quiet period,
+ * but no later than the maximum delay after the first one of the burst.
+ */
+static void
+schedule_settled_state_fetch (CcDisplayConfigManager *manager)
+{
+  int64_t elapsed_ms;
+  unsigned int delay_ms;
+
+  elapsed_ms = (g_get_monotonic_time () - manager->burst_start_time) / 1000;
+  if (elapsed_ms >= manager->max_delay_ms)
+    delay_ms = 0;
+  else
+    delay_ms = MIN (manager->quiet_period_ms,
+                    manager->max_delay_ms - elapsed_ms);
 
-  return cc_dbus_display_config_call_apply_monitors_config_sync (
-    proxy,
-    serial,
-    method,
-    logical_monitor_configs_variant,
-    g_variant_builder_end (&properties_builder),
-    NULL,
-    error);
+  g_clear_handle_id (&manager->quiet_timeout_id, g_source_remove);
+  manager->quiet_timeout_id = g_timeout_add (delay_ms,
+                                             on_quiet_period_elapsed,
+                                             manager);
 }
 
+/*
+ * Docks and KVM switches make the compositor emit bursts of MonitorsChanged.
+ * Rather than fetching and parsing the state for every one of them, a single
+ * "state-changed" is emitted per burst, and none if the serial didn't change.
+ */
+static void
+on_monitors_changed (CcDbusDisplayConfig *proxy,
+                     CcDisplayConfigManager *manager)
+{
+  manager->monitors_changed_stats.n_signals++;
+
+  if (manager->burst_start_time == 0)
+    manager->burst_start_time = g_get_monotonic_time ();
+  else
+    manager->monitors_changed_stats.n_suppressed++;
+
+  if (manager->fetch_cancellable)
+    {
+      manager->changed_during_fetch = TRUE;
+      return;
+    }
+
+  schedule_settled_state_fetch (manager);
+}
+
+void
+cc_display_config_manager_set_monitors_changed_delays (CcDisplayConfigManager *manager,
+                                                       unsigned int quiet_period_ms,
+                                                       unsigned int max_delay_ms)
+{
+  manager->quiet_period_ms = quiet_period_ms;
+  manager->max_delay_ms = MAX (max_delay_ms, quiet_period_ms);
+}
+
+void
+cc_display_config_manager_get_monitors_changed_stats (CcDisplayConfigManager *manager,
+                                                      CcDisplayMonitorsChangedStats *stats)
+{
+  *stats = manager->monitors_changed_stats;
+}
+
+/*
+ * Creates a manager talking to the compositor on the message bus at @address,
+ * or on the session bus of the calling process if @address is NULL.
+ */
 CcDisplayConfigManager *
-cc_display_config_manager_new (GError **error)
+cc_display_config_manager_new_for_address (const char *address,
+                                           CcDisplayConfigManagerFlags flags,
+                                           GError **error)
 {
   g_autoptr(CcDisplayConfigManager) manager = NULL;
 
   manager = g_object_new (CC_TYPE_DISPLAY_CONFIG_MANAGER, NULL);
+  manager->flags = flags;
+  manager->address = g_strdup (address);
   if (!g_initable_init (G_INITABLE (manager), NULL, error))
     return NULL;
 
   return g_steal_pointer (&manager);
 }
 
+CcDisplayConfigManager *
+cc_display_config_manager_new_with_flags (CcDisplayConfigManagerFlags flags,
+                                          GError **error)
+{
+  return cc_display_config_manager_new_for_address (NULL, flags, error);
+}
+
+CcDisplayConfigManager *
+cc_display_config_manager_new (GError **error)
+{
+  return cc_display_config_manager_new_with_flags (CC_DISPLAY_CONFIG_MANAGER_FLAGS_NONE,
+                                                   error);
+}
+
+static GDBusConnection *
+open_connection (const char *address,
+                 GCancellable *cancellable,
+                 GError **error)
+{
+  if (address)
+    {
+      return g_dbus_connection_new_for_address_sync (address,
+                                                     G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                                     G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+                                                     NULL,
+                                                     cancellable, error);
+    }
+  else
+    {
+      return g_bus_get_sync (G_BUS_TYPE_SESSION, cancellable, error);
+    }
+}
+
+typedef struct _CompositorWait
+{
+  GMainLoop *loop;
+  gboolean appeared;
+} CompositorWait;
+
+static void
+on_display_config_appeared (GDBusConnection *connection,
+                            const char *name,
+                            const char *name_owner,
+                            gpointer user_data)
+{
+  CompositorWait *wait = user_data;
+
+  wait->appeared = TRUE;
+  g_main_loop_quit (wait->loop);
+}
+
 static gboolean
-cc_display_config_manager_initable_init (GInitable *initable,
-                                         GCancellable *cancellable,
-                                         GError **error)
+on_wait_for_compositor_timeout (gpointer user_data)
+{
+  CompositorWait *wait = user_data;
+
+  g_main_loop_quit (wait->loop);
+
+  return G_SOURCE_REMOVE;
+}
+
+/*
+ * Blocks until the compositor owns its DisplayConfig name on the message bus
+ * at @address, or on the session bus if @address is NULL. The name owner is
+ * watched rather than polled, so this returns as soon as the compositor
+ * claims the name. Unless @timeout_ms is -1, it fails with
+ * G_IO_ERROR_TIMED_OUT once that expired. The time spent waiting is returned
+ * in @waited_us either way.
+ */
+gboolean
+cc_display_config_manager_wait_for_compositor (const char *address,
+                                               int timeout_ms,
+                                               int64_t *waited_us,
+                                               GError **error)
+{
+  g_autoptr(GDBusConnection) connection = NULL;
+  g_autoptr(GMainContext) context = NULL;
+  g_autoptr(GMainLoop) loop = NULL;
+  g_autoptr(GSource) timeout_source = NULL;
+  CompositorWait wait = { 0 };
+  unsigned int watch_id;
+  int64_t start_time;
+
+  start_time = g_get_monotonic_time ();
+  if (waited_us)
+    *waited_us = 0;
+
+  connection = open_connection (address, NULL, error);
+  if (!connection)
+    return FALSE;
+
+  /* Don't dispatch the sources of the caller while waiting */
+  context = g_main_context_new ();
+  g_main_context_push_thread_default (context);
+
+  loop = g_main_loop_new (context, FALSE);
+  wait.loop = loop;
+
+  watch_id = g_bus_watch_name_on_connection (connection,
+                                             DISPLAY_CONFIG_BUS_NAME,
+                                             G_BUS_NAME_WATCHER_FLAGS_NONE,
+                                             on_display_config_appeared,
+                                             NULL,
+                                             &wait, NULL);
+
+  if (timeout_ms >= 0)
+    {
+      timeout_source = g_timeout_source_new (timeout_ms);
+      g_source_set_callback (timeout_source,
+                             on_wait_for_compositor_timeout,
+                             &wait, NULL);
+      g_source_attach (timeout_source, context);
+    }
+
+  g_main_loop_run (loop);
+
+  g_bus_unwatch_name (watch_id);
+  if (timeout_source)
+    g_source_destroy (timeout_source);
+  g_main_context_pop_thread_default (context);
+
+  if (waited_us)
+    *waited_us = g_get_monotonic_time () - start_time;
+
+  if (!wait.appeared)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                   "%s did not appear within %d ms",
+                   DISPLAY_CONFIG_BUS_NAME, timeout_ms);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+connect_display_config (CcDisplayConfigManager *manager,
+                        GCancellable *cancellable,
+                        GError **error)
 {
-  CcDisplayConfigManager *manager = CC_DISPLAY_CONFIG_MANAGER (initable);
   CcDbusDisplayConfig *proxy;
 
-  proxy = cc_dbus_display_config_proxy_new_for_bus_sync (G_BUS_TYPE_SESSION,
-                                                         G_DBUS_PROXY_FLAGS_NONE,
-                                                         "org.gnome.Mutter.DisplayConfig",
-                                                         "/org/gnome/Mutter/DisplayConfig",
-                                                         NULL, error);
+  manager->connection = open_connection (manager->address,
+                                         cancellable, error);
+  if (!manager->connection)
+    return FALSE;
+
+  /*
+   * One-shot managers only issue method calls, so skip creating a proxy and
+   * the synchronous property loading and signal subscription it implies.
+   */
+  if (manager->flags & CC_DISPLAY_CONFIG_MANAGER_FLAGS_ONE_SHOT)
+    return TRUE;
+
+  proxy = cc_dbus_display_config_proxy_new_sync (manager->connection,
+                                                 G_DBUS_PROXY_FLAGS_NONE,
+                                                 DISPLAY_CONFIG_BUS_NAME,
+                                                 DISPLAY_CONFIG_OBJECT_PATH,
+                                                 cancellable, error);
   if (!proxy)
     return FALSE;
 
   manager->proxy = proxy;
+  manager->main_context = g_main_context_ref_thread_default ();
+  g_signal_connect (proxy, "monitors-changed",
+                    G_CALLBACK (on_monitors_changed), manager);
 
   return TRUE;
 }
 
+static gboolean
+cc_display_config_manager_initable_init (GInitable *initable,
+                                         GCancellable *cancellable,
+                                         GError **error)
+{
+  CcDisplayConfigManager *manager = CC_DISPLAY_CONFIG_MANAGER (initable);
+  gboolean ret;
+  GMC_TRACE_BEGIN (initable_init);
+
+  ret = connect_display_config (manager, cancellable, error);
+
+  GMC_TRACE_END (initable_init, 0, 0, 0);
+
+  return ret;
+}
+
 static void
 cc_display_config_manager_initable_init_iface (GInitableIface *iface)
 {
@@ -238,9 +1065,48 @@ cc_display_config_manager_initable_init_iface (GInitableIface *iface)
 static void
 cc_display_config_manager_init (CcDisplayConfigManager *config_manager)
 {
+  config_manager->quiet_period_ms = DEFAULT_QUIET_PERIOD_MS;
+  config_manager->max_delay_ms = DEFAULT_MAX_DELAY_MS;
+}
+
+static void
+cc_display_config_manager_finalize (GObject *object)
+{
+  CcDisplayConfigManager *manager = CC_DISPLAY_CONFIG_MANAGER (object);
+
+  if (manager->proxy)
+    g_signal_handlers_disconnect_by_func (manager->proxy,
+                                          on_monitors_changed, manager);
+  g_clear_handle_id (&manager->quiet_timeout_id, g_source_remove);
+  g_cancellable_cancel (manager->fetch_cancellable);
+  g_clear_object (&manager->fetch_cancellable);
+  publish_current_state (manager, NULL);
+
+  g_clear_object (&manager->proxy);
+  g_clear_pointer (&manager->main_context, g_main_context_unref);
+  g_clear_object (&manager->connection);
+  g_free (manager->address);
+
+  G_OBJECT_CLASS (cc_display_config_manager_parent_class)->finalize (object);
 }
 
 static void
 cc_display_config_manager_class_init (CcDisplayConfigManagerClass *klass)
 {
+  GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+  object_class->finalize = cc_display_config_manager_finalize;
+
+  /*
+   * Emitted with the settled CcDisplayState after a burst of MonitorsChanged.
+   * Handlers keeping the state around take a reference.
+   */
+  signals[STATE_CHANGED] =
+    g_signal_new ("state-changed",
+                  G_TYPE_FROM_CLASS (klass),
+                  G_SIGNAL_RUN_LAST,
+                  0,
+                  NULL, NULL, NULL,
+                  G_TYPE_NONE, 1,
+                  G_TYPE_POINTER);
 }
@@ -17,9 +17,35 @@
  *
  */
 
+#ifndef _CC_DISPLAY_CONFIG_MANAGER_H
+#define _CC_DISPLAY_CONFIG_MANAGER_H
+
 #include <glib-object.h>
+#include <stdint.h>
 
 #include "gmc-display-config.h"
+#include "gmc-display-transition.h"
+
+typedef enum _CcDisplayConfigManagerFlags
+{
+  CC_DISPLAY_CONFIG_MANAGER_FLAGS_NONE = 0,
+  CC_DISPLAY_CONFIG_MANAGER_FLAGS_ONE_SHOT = 1 << 0
+} CcDisplayConfigManagerFlags;
+
+/* Counters of the MonitorsChanged coalescing */
+typedef struct _CcDisplayMonitorsChangedStats
+{
+  /* MonitorsChanged signals received */
+  unsigned int n_signals;
+  /* Signals folded into the burst of an earlier one */
+  unsigned int n_suppressed;
+  /* Fetched states discarded because monitors changed meanwhile */
+  unsigned int n_stale_states;
+  /* Settled states with the serial of the previous one, not emitted */
+  unsigned int n_duplicates;
+  /* "state-changed" emissions */
+  unsigned int n_settled;
+} CcDisplayMonitorsChangedStats;
 
 #define CC_TYPE_DISPLAY_CONFIG_MANAGER (cc_display_config_manager_get_type ())
 G_DECLARE_FINAL_TYPE (CcDisplayConfigManager, cc_display_config_manager,
@@ -28,10 +54,73 @@ G_DECLARE_FINAL_TYPE (CcDisplayConfigManager, cc_display_config_manager,
 CcDisplayState * cc_display_config_manager_new_current_state (CcDisplayConfigManager *manager,
 							      GError **error);
 
+CcDisplayState * cc_display_config_manager_dup_current_state (CcDisplayConfigManager *manager);
+
+GVariant * cc_display_config_manager_get_current_state_variant (CcDisplayConfigManager *manager,
+								 GError **error);
+
+gboolean cc_display_config_manager_wait_for_compositor (const char *address,
+							int timeout_ms,
+							int64_t *waited_us,
+							GError **error);
+
 CcDisplayConfigManager * cc_display_config_manager_new (GError **error);
 
+CcDisplayConfigManager * cc_display_config_manager_new_with_flags (CcDisplayConfigManagerFlags flags,
+								   GError **error);
+
+CcDisplayConfigManager * cc_display_config_manager_new_for_address (const char *address,
+								    CcDisplayConfigManagerFlags flags,
+								    GError **error);
+
 gboolean cc_display_config_manager_apply (CcDisplayConfigManager *manager,
 					  CcDisplayState *state,
 					  CcDisplayConfig *config,
 					  CcDisplayConfigMethod method,
 					  GError **error);
+
+gboolean cc_display_config_manager_apply_transition (CcDisplayConfigManager *manager,
+						     CcDisplayState *state,
+						     CcDisplayTransition *transition,
+						     CcDisplayConfigMethod method,
+						     GError **error);
+
+gboolean cc_display_config_manager_apply_transition_full (CcDisplayConfigManager *manager,
+							  CcDisplayState *state,
+							  CcDisplayTransition *transition,
+							  CcDisplayConfigMethod method,
+							  unsigned int *n_applied_steps,
+							  GError **error);
+
+/* A configuration serialized ahead of time, for reverting to it quickly */
+typedef struct _CcDisplayConfigSnapshot CcDisplayConfigSnapshot;
+
+CcDisplayConfigSnapshot * cc_display_config_snapshot_new (CcDisplayState *state);
+
+void cc_display_config_snapshot_free (CcDisplayConfigSnapshot *snapshot);
+
+gboolean cc_display_config_manager_restore_snapshot (CcDisplayConfigManager *manager,
+						     CcDisplayConfigSnapshot *snapshot,
+						     GError **error);
+
+CcDisplayPowerSaveMode cc_display_config_manager_get_power_save_mode (CcDisplayConfigManager *manager);
+
+gboolean cc_display_config_manager_set_power_save_mode (CcDisplayConfigManager *manager,
+							CcDisplayPowerSaveMode mode,
+							int64_t *latency_us,
+							GError **error);
+
+/*
+ * A burst of MonitorsChanged ends once none arrived for @quiet_period_ms, or
+ * @max_delay_ms after its first signal. Not available in one-shot managers.
+ */
+void cc_display_config_manager_set_monitors_changed_delays (CcDisplayConfigManager *manager,
+							    unsigned int quiet_period_ms,
+							    unsigned int max_delay_ms);
+
+void cc_display_config_manager_get_monitors_changed_stats (CcDisplayConfigManager *manager,
+							   CcDisplayMonitorsChangedStats *stats);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (CcDisplayConfigSnapshot, cc_display_config_snapshot_free)
+
+#endif /* _CC_DISPLAY_CONFIG_MANAGER_H */
@@ -19,39 +19,64 @@
 
 #include "gmc-display-config.h"
 #include "gmc-dbus-display-config.h"
+#include "gmc-trace.h"
 
+#include <float.h>
+#include <math.h>
 #include <glib-object.h>
 #include <stdint.h>
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define CC_DBUS_DISPLAY_CONFIG_MODE_FLAGS_PREFERRED (1 << 0)
 #define CC_DBUS_DISPLAY_CONFIG_MODE_FLAGS_CURRENT (1 << 1)
+#define CC_DBUS_DISPLAY_CONFIG_MODE_FLAGS_INTERLACED (1 << 2)
+
+/*
+ * Identity strings, i.e. mode ids and the connector, vendor, product and
+ * serial of monitors, are interned with g_intern_string(). They are shared
+ * by all states and compared by pointer.
+ */
 
 typedef struct _CcDisplayMode
 {
-  char *id;
+  const char *id;
   int resolution_width;
   int resolution_height;
   double refresh_rate;
   double preferred_scale;
   unsigned int flags;
+  /* Points into the scales of the mode table once the state is parsed */
   double *supported_scales;
   int n_supported_scales;
 } CcDisplayMode;
 
 typedef struct _CcDisplayMonitor
 {
-  char *connector;
-  char *vendor;
-  char *product;
-  char *serial;
+  /* Not a reference; the state owns the monitor */
+  CcDisplayState *state;
+
+  const char *connector;
+  const char *vendor;
+  const char *product;
+  const char *serial;
 
   GList *modes;
   CcDisplayMode *current_mode;
   CcDisplayMode *preferred_mode;
 
+  /* Modes ordered best first, see compare_modes() */
+  GPtrArray *ranked_modes;
+  CcDisplayMode *highest_refresh_mode;
+
   char *display_name;
+  gboolean is_builtin;
+
+  /* Rows of the modes in the mode table of the state */
+  unsigned int first_mode_row;
+  unsigned int n_mode_rows;
 } CcDisplayMonitor;
 
 typedef struct _CcDisplayLogicalMonitor
@@ -64,8 +89,56 @@ typedef struct _CcDisplayLogicalMonitor
   bool is_primary;
 } CcDisplayLogicalMonitor;
 
+/*
+ * The modes of all monitors stored column-wise, one row per mode, with the
+ * rows of each monitor next to each other. See cc_display_state_filter_modes().
+ */
+typedef struct _CcDisplayModeTable
+{
+  unsigned int n_rows;
+  CcDisplayMode **modes;
+  CcDisplayMonitor **monitors;
+  int32_t *widths;
+  int32_t *heights;
+  double *refresh_rates;
+  double *preferred_scales;
+  uint32_t *flags;
+  /* The supported scales of a row are n_scales[row] values from scales_offsets[row] on */
+  uint32_t *scales_offsets;
+  uint32_t *n_scales;
+  double *scales;
+} CcDisplayModeTable;
+
+/*
+ * The rects of the logical monitors over a grid whose lines are their
+ * distinct edges. Each cell holds the logical monitor covering it, so the
+ * one at a point is found with two binary searches. Logical monitors of a
+ * state don't overlap; should they, a cell keeps the first one. See
+ * build_spatial_index().
+ */
+typedef struct _CcDisplaySpatialIndex
+{
+  unsigned int n_rects;
+  CcDisplayLogicalMonitor **logical_monitors;
+  cairo_rectangle_int_t *rects;
+  /* Sorted grid lines */
+  unsigned int n_xs;
+  int *xs;
+  unsigned int n_ys;
+  int *ys;
+  /* (n_xs - 1) * (n_ys - 1) cells, row by row: 0 if uncovered, otherwise
+   * the index of the covering logical monitor plus one */
+  uint32_t *cells;
+} CcDisplaySpatialIndex;
+
+/*
+ * A state is never modified once parsed, so it can be shared between
+ * threads; the reference count is the only mutable field.
+ */
 struct _CcDisplayState
 {
+  gatomicrefcount ref_count;
+
   unsigned int serial;
 
   GList *monitors;
@@ -74,10 +147,21 @@ struct _CcDisplayState
   gboolean has_max_screen_size;
   int max_screen_width;
   int max_screen_height;
+
+  CcDisplayLayoutMode layout_mode;
+  gboolean supports_changing_layout_mode;
+
+  /* Selector -> GPtrArray of CcDisplayMonitor, see build_monitor_index() */
+  GHashTable *monitor_index;
+
+  CcDisplayModeTable mode_table;
+  CcDisplaySpatialIndex spatial_index;
 };
 
 typedef struct _CcDisplayMonitorConfig
 {
+  /* Keeps the state the monitor and mode belong to alive */
+  CcDisplayState *state;
   CcDisplayMonitor *monitor;
   CcDisplayMode *mode;
 } CcDisplayMonitorConfig;
@@ -105,6 +189,24 @@ cc_display_monitor_get_connector (CcDisplayMonitor *monitor)
   return monitor->connector;
 }
 
+const char *
+cc_display_monitor_get_vendor (CcDisplayMonitor *monitor)
+{
+  return monitor->vendor;
+}
+
+const char *
+cc_display_monitor_get_product (CcDisplayMonitor *monitor)
+{
+  return monitor->product;
+}
+
+const char *
+cc_display_monitor_get_serial (CcDisplayMonitor *monitor)
+{
+  return monitor->serial;
+}
+
 const char *
 cc_display_monitor_get_display_name (CcDisplayMonitor *monitor)
 {
@@ -120,7 +222,18 @@ cc_display_monitor_is_active (CcDisplayMonitor *monitor)
 bool
 cc_display_monitor_is_builtin_display (CcDisplayMonitor *monitor)
 {
-  return false;
+  return monitor->is_builtin;
+}
+
+/*
+ * Returns "vendor:product:serial", which unlike the connector stays the same
+ * when the monitor is plugged in elsewhere.
+ */
+char *
+cc_display_monitor_dup_identity (CcDisplayMonitor *monitor)
+{
+  return g_strdup_printf ("%s:%s:%s",
+                          monitor->vendor, monitor->product, monitor->serial);
 }
 
 CcDisplayMode *
@@ -141,29 +254,183 @@ cc_display_monitor_get_modes (CcDisplayMonitor *monitor)
   return monitor->modes;
 }
 
+/*
+ * Returns the interned copy of @string, or NULL if it was never interned, in
+ * which case it can't be the identity string of any monitor or mode.
+ */
+static const char *
+lookup_interned_string (const char *string)
+{
+  GQuark quark;
+
+  quark = g_quark_try_string (string);
+  if (!quark)
+    return NULL;
+
+  return g_quark_to_string (quark);
+}
+
 CcDisplayMode *
 cc_display_monitor_lookup_mode (CcDisplayMonitor *monitor,
                                 const char *mode_id)
 {
   GList *l;
 
+  mode_id = lookup_interned_string (mode_id);
+  if (!mode_id)
+    return NULL;
+
   for (l = monitor->modes; l; l = l->next)
     {
       CcDisplayMode *mode = l->data;
 
-      if (g_str_equal (mode->id, mode_id))
+      if (mode->id == mode_id)
         return mode;
     }
 
   return NULL;
 }
 
+static int
+compare_resolutions (int width_a,
+                     int height_a,
+                     int width_b,
+                     int height_b)
+{
+  int64_t area_a = (int64_t) width_a * height_a;
+  int64_t area_b = (int64_t) width_b * height_b;
+
+  if (area_a != area_b)
+    return area_a > area_b ? -1 : 1;
+  if (width_a != width_b)
+    return width_a > width_b ? -1 : 1;
+
+  return 0;
+}
+
+/*
+ * Orders modes best first: by resolution, then refresh rate, then
+ * progressive before interlaced.
+ */
+static int
+compare_modes (gconstpointer a,
+               gconstpointer b)
+{
+  const CcDisplayMode *mode_a = *(CcDisplayMode **) a;
+  const CcDisplayMode *mode_b = *(CcDisplayMode **) b;
+  bool is_interlaced_a, is_interlaced_b;
+  int result;
+
+  result = compare_resolutions (mode_a->resolution_width,
+                                mode_a->resolution_height,
+                                mode_b->resolution_width,
+                                mode_b->resolution_height);
+  if (result != 0)
+    return result;
+
+  if (mode_a->refresh_rate != mode_b->refresh_rate)
+    return mode_a->refresh_rate > mode_b->refresh_rate ? -1 : 1;
+
+  is_interlaced_a = mode_a->flags & CC_DBUS_DISPLAY_CONFIG_MODE_FLAGS_INTERLACED;
+  is_interlaced_b = mode_b->flags & CC_DBUS_DISPLAY_CONFIG_MODE_FLAGS_INTERLACED;
+
+  return is_interlaced_a - is_interlaced_b;
+}
+
+static void
+rank_modes (CcDisplayMonitor *monitor)
+{
+  GList *l;
+  unsigned int i;
+
+  monitor->ranked_modes = g_ptr_array_sized_new (g_list_length (monitor->modes));
+  for (l = monitor->modes; l; l = l->next)
+    g_ptr_array_add (monitor->ranked_modes, l->data);
+  g_ptr_array_sort (monitor->ranked_modes, compare_modes);
+
+  for (i = 0; i < monitor->ranked_modes->len; i++)
+    {
+      CcDisplayMode *mode = g_ptr_array_index (monitor->ranked_modes, i);
+
+      if (!monitor->highest_refresh_mode ||
+          mode->refresh_rate > monitor->highest_refresh_mode->refresh_rate)
+        monitor->highest_refresh_mode = mode;
+    }
+}
+
+CcDisplayMode *
+cc_display_monitor_get_max_resolution_mode (CcDisplayMonitor *monitor)
+{
+  if (monitor->ranked_modes->len == 0)
+    return NULL;
+
+  return g_ptr_array_index (monitor->ranked_modes, 0);
+}
+
+CcDisplayMode *
+cc_display_monitor_get_highest_refresh_mode (CcDisplayMonitor *monitor)
+{
+  return monitor->highest_refresh_mode;
+}
+
+CcDisplayMode *
+cc_display_monitor_get_best_mode_for_resolution (CcDisplayMonitor *monitor,
+                                                 int width,
+                                                 int height)
+{
+  GPtrArray *ranked_modes = monitor->ranked_modes;
+  unsigned int low = 0;
+  unsigned int high = ranked_modes->len;
+  CcDisplayMode *mode;
+
+  while (low < high)
+    {
+      unsigned int middle = low + (high - low) / 2;
+
+      mode = g_ptr_array_index (ranked_modes, middle);
+      if (compare_resolutions (mode->resolution_width,
+                               mode->resolution_height,
+                               width, height) < 0)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+  if (low == ranked_modes->len)
+    return NULL;
+
+  mode = g_ptr_array_index (ranked_modes, low);
+  if (mode->resolution_width != width || mode->resolution_height != height)
+    return NULL;
+
+  return mode;
+}
+
+CcDisplayMode *
+cc_display_monitor_get_native_mode (CcDisplayMonitor *monitor)
+{
+  CcDisplayMode *preferred_mode = monitor->preferred_mode;
+
+  if (!preferred_mode)
+    return cc_display_monitor_get_max_resolution_mode (monitor);
+
+  return cc_display_monitor_get_best_mode_for_resolution (monitor,
+                                                          preferred_mode->resolution_width,
+                                                          preferred_mode->resolution_height);
+}
+
 const char *
 cc_display_mode_get_id (CcDisplayMode *mode)
 {
   return mode->id;
 }
 
+bool
+cc_display_mode_is_interlaced (CcDisplayMode *mode)
+{
+  return mode->flags & CC_DBUS_DISPLAY_CONFIG_MODE_FLAGS_INTERLACED;
+}
+
 void
 cc_display_mode_get_resolution (CcDisplayMode *mode,
                                 int *width,
@@ -188,7 +455,6 @@ cc_display_mode_get_preferred_scale (CcDisplayMode *mode)
 static void
 cc_display_mode_free (CcDisplayMode *mode)
 {
-  g_free (mode->id);
   g_free (mode);
 }
 
@@ -223,10 +489,24 @@ cc_display_state_get_max_screen_size (CcDisplayState *state,
   return TRUE;
 }
 
+CcDisplayLayoutMode
+cc_display_state_get_layout_mode (CcDisplayState *state)
+{
+  return state->layout_mode;
+}
+
+gboolean
+cc_display_state_supports_changing_layout_mode (CcDisplayState *state)
+{
+  return state->supports_changing_layout_mode;
+}
+
 #define MODE_BASE_FORMAT "siiddad"
 #define MODE_FORMAT "(" MODE_BASE_FORMAT "a{sv})"
 #define MODES_FORMAT "a" MODE_FORMAT
 #define MONITOR_SPEC_FORMAT "(ssss)"
+/* For getting the strings of a monitor spec without copying them */
+#define MONITOR_SPEC_BORROWED_FORMAT "(&s&s&s&s)"
 #define MONITOR_FORMAT "(" MONITOR_SPEC_FORMAT MODES_FORMAT "@a{sv})"
 #define MONITORS_FORMAT "a" MONITOR_FORMAT
 
@@ -237,7 +517,7 @@ static CcDisplayMode *
 cc_display_mode_new_from_variant (GVariant *mode_variant)
 {
   CcDisplayMode *mode;
-  char *mode_id;
+  const char *mode_id;
   int32_t resolution_width;
   int32_t resolution_height;
   double refresh_rate;
@@ -247,9 +527,11 @@ cc_display_mode_new_from_variant (GVariant *mode_variant)
   GVariant *properties_variant;
   gboolean is_current;
   gboolean is_preferred;
+  gboolean is_interlaced;
   int i = 0;
+  GMC_TRACE_BEGIN (mode_new_from_variant);
 
-  g_variant_get (mode_variant, "(" MODE_BASE_FORMAT "@a{sv})",
+  g_variant_get (mode_variant, "(&" MODE_BASE_FORMAT "@a{sv})",
                  &mode_id,
                  &resolution_width,
                  &resolution_height,
@@ -260,7 +542,7 @@ cc_display_mode_new_from_variant (GVariant *mode_variant)
 
   mode = g_new0 (CcDisplayMode, 1);
   *mode = (CcDisplayMode) {
-    .id = mode_id,
+    .id = g_intern_string (mode_id),
     .resolution_width = resolution_width,
     .resolution_height = resolution_height,
     .refresh_rate = refresh_rate,
@@ -275,21 +557,30 @@ cc_display_mode_new_from_variant (GVariant *mode_variant)
 
       g_variant_get (scale_variant, "d", &scale);
       mode->supported_scales[i++] = scale;
+
+      g_variant_unref (scale_variant);
     }
 
   if (!g_variant_lookup (properties_variant, "is-current", "b", &is_current))
     is_current = FALSE;
   if (!g_variant_lookup (properties_variant, "is-preferred", "b", &is_preferred))
     is_preferred = FALSE;
+  if (!g_variant_lookup (properties_variant, "is-interlaced", "b", &is_interlaced))
+    is_interlaced = FALSE;
 
   if (is_current)
     mode->flags |= CC_DBUS_DISPLAY_CONFIG_MODE_FLAGS_CURRENT;
   if (is_preferred)
     mode->flags |= CC_DBUS_DISPLAY_CONFIG_MODE_FLAGS_PREFERRED;
+  if (is_interlaced)
+    mode->flags |= CC_DBUS_DISPLAY_CONFIG_MODE_FLAGS_INTERLACED;
 
   g_variant_iter_free (supported_scales_iter);
   g_variant_unref (properties_variant);
 
+  GMC_TRACE_END (mode_new_from_variant,
+                 0, 1, g_variant_get_size (mode_variant));
+
   return mode;
 }
 
@@ -297,20 +588,30 @@ static CcDisplayMonitor *
 cc_display_monitor_new_from_variant (GVariant *monitor_variant)
 {
   CcDisplayMonitor *monitor;
+  const char *connector;
+  const char *vendor;
+  const char *product;
+  const char *serial;
   GVariantIter *modes_iter;
   GVariant *properties_variant;
   GVariant *mode_variant;
-  GVariant *display_name_variant;
+  g_autoptr(GVariant) display_name_variant = NULL;
+  GMC_TRACE_BEGIN (monitor_new_from_variant);
 
   monitor = g_new0 (CcDisplayMonitor, 1);
 
-  g_variant_get (monitor_variant, MONITOR_FORMAT,
-                 &monitor->connector,
-                 &monitor->vendor,
-                 &monitor->product,
-                 &monitor->serial,
+  g_variant_get (monitor_variant,
+                 "(" MONITOR_SPEC_BORROWED_FORMAT MODES_FORMAT "@a{sv})",
+                 &connector,
+                 &vendor,
+                 &product,
+                 &serial,
                  &modes_iter,
                  &properties_variant);
+  monitor->connector = g_intern_string (connector);
+  monitor->vendor = g_intern_string (vendor);
+  monitor->product = g_intern_string (product);
+  monitor->serial = g_intern_string (serial);
 
   while ((mode_variant = g_variant_iter_next_value (modes_iter)))
     {
@@ -335,6 +636,8 @@ cc_display_monitor_new_from_variant (GVariant *monitor_variant)
     }
   g_variant_iter_free (modes_iter);
 
+  rank_modes (monitor);
+
   display_name_variant = g_variant_lookup_value (properties_variant,
                                                  "display-name",
                                                  G_VARIANT_TYPE ("s"));
@@ -344,6 +647,16 @@ cc_display_monitor_new_from_variant (GVariant *monitor_variant)
                      &monitor->display_name);
     }
 
+  if (!g_variant_lookup (properties_variant, "is-builtin", "b",
+                         &monitor->is_builtin))
+    monitor->is_builtin = FALSE;
+
+  g_variant_unref (properties_variant);
+
+  GMC_TRACE_END (monitor_new_from_variant,
+                 1, g_list_length (monitor->modes),
+                 g_variant_get_size (monitor_variant));
+
   return monitor;
 }
 
@@ -367,6 +680,7 @@ get_monitors_from_variant (CcDisplayState *state,
       CcDisplayMonitor *monitor;
 
       monitor = cc_display_monitor_new_from_variant (monitor_variant);
+      monitor->state = state;
       state->monitors = g_list_append (state->monitors, monitor);
 
       g_variant_unref (monitor_variant);
@@ -382,14 +696,19 @@ monitor_from_spec (CcDisplayState *state,
 {
   GList *l;
 
+  connector = lookup_interned_string (connector);
+  vendor = lookup_interned_string (vendor);
+  product = lookup_interned_string (product);
+  serial = lookup_interned_string (serial);
+
   for (l = state->monitors; l; l = l->next)
     {
       CcDisplayMonitor *monitor = l->data;
 
-      if (g_strcmp0 (monitor->connector, connector) == 0 &&
-          g_strcmp0 (monitor->vendor, vendor) == 0 &&
-          g_strcmp0 (monitor->product, product) == 0 &&
-          g_strcmp0 (monitor->serial, serial) == 0)
+      if (monitor->connector == connector &&
+          monitor->vendor == vendor &&
+          monitor->product == product &&
+          monitor->serial == serial)
         return monitor;
     }
 
@@ -407,7 +726,8 @@ cc_display_logical_monitor_new_from_variant (CcDisplayState *state,
   double scale;
   CcDisplayTransform transform;
   gboolean is_primary;
-  GVariant *properties;
+  g_autoptr(GVariant) properties = NULL;
+  GMC_TRACE_BEGIN (logical_monitor_new_from_variant);
 
   logical_monitor = g_new0 (CcDisplayLogicalMonitor, 1);
 
@@ -423,12 +743,12 @@ cc_display_logical_monitor_new_from_variant (CcDisplayState *state,
   while ((monitor_spec_variant = g_variant_iter_next_value (monitor_specs_iter)))
     {
       CcDisplayMonitor *monitor;
-      g_autofree char *connector = NULL;
-      g_autofree char *vendor = NULL;
-      g_autofree char *product = NULL;
-      g_autofree char *serial = NULL;
+      const char *connector;
+      const char *vendor;
+      const char *product;
+      const char *serial;
 
-      g_variant_get (monitor_spec_variant, MONITOR_SPEC_FORMAT,
+      g_variant_get (monitor_spec_variant, MONITOR_SPEC_BORROWED_FORMAT,
                      &connector, &vendor, &product, &serial);
 
       monitor = monitor_from_spec (state, connector, vendor, product, serial);
@@ -436,19 +756,21 @@ cc_display_logical_monitor_new_from_variant (CcDisplayState *state,
         {
           g_warning ("Couldn't find monitor given spec: %s, %s, %s, %s\n",
                      connector, vendor, product, serial);
+          g_variant_unref (monitor_spec_variant);
           continue;
         }
 
+      g_variant_unref (monitor_spec_variant);
+
       logical_monitor->monitors = g_list_append (logical_monitor->monitors,
                                                  monitor);
-
-      g_variant_unref (monitor_spec_variant);
     }
   g_variant_iter_free (monitor_specs_iter);
 
   if (!logical_monitor->monitors)
     {
       g_warning ("Got an empty logical monitor, ignoring\n");
+      g_free (logical_monitor);
       return NULL;
     }
 
@@ -458,6 +780,10 @@ cc_display_logical_monitor_new_from_variant (CcDisplayState *state,
   logical_monitor->transform = transform;
   logical_monitor->is_primary = is_primary;
 
+  GMC_TRACE_END (logical_monitor_new_from_variant,
+                 g_list_length (logical_monitor->monitors), 0,
+                 g_variant_get_size (logical_monitor_variant));
+
   return logical_monitor;
 }
 
@@ -498,6 +824,72 @@ cc_display_logical_monitor_calculate_layout (CcDisplayLogicalMonitor *logical_mo
   };
 }
 
+static void
+calculate_rect (int x,
+                int y,
+                int width,
+                int height,
+                CcDisplayTransform transform,
+                double scale,
+                CcDisplayLayoutMode layout_mode,
+                cairo_rectangle_int_t *rect)
+{
+  switch (transform)
+    {
+    case CC_DISPLAY_TRANSFORM_90:
+    case CC_DISPLAY_TRANSFORM_270:
+    case CC_DISPLAY_TRANSFORM_FLIPPED_90:
+    case CC_DISPLAY_TRANSFORM_FLIPPED_270:
+      {
+        int tmp = width;
+
+        width = height;
+        height = tmp;
+        break;
+      }
+    default:
+      break;
+    }
+
+  if (layout_mode == CC_DISPLAY_LAYOUT_MODE_LOGICAL && scale > 0)
+    {
+      width = (int) round (width / scale);
+      height = (int) round (height / scale);
+    }
+
+  *rect = (cairo_rectangle_int_t) {
+    .x = x,
+    .y = y,
+    .width = width,
+    .height = height
+  };
+}
+
+/*
+ * Calculates the area @logical_monitor covers in the layout, taking the
+ * transform into account and, in the logical layout mode, the scale.
+ */
+void
+cc_display_logical_monitor_calculate_rect (CcDisplayLogicalMonitor *logical_monitor,
+                                           CcDisplayLayoutMode layout_mode,
+                                           cairo_rectangle_int_t *rect)
+{
+  CcDisplayMonitor *monitor;
+
+  g_return_if_fail (logical_monitor->monitors);
+
+  monitor = logical_monitor->monitors->data;
+
+  calculate_rect (logical_monitor->x,
+                  logical_monitor->y,
+                  monitor->current_mode->resolution_width,
+                  monitor->current_mode->resolution_height,
+                  logical_monitor->transform,
+                  logical_monitor->scale,
+                  layout_mode,
+                  rect);
+}
+
 double
 cc_display_logical_monitor_get_scale (CcDisplayLogicalMonitor *logical_monitor)
 {
@@ -529,6 +921,7 @@ get_logical_monitors_from_variant (CcDisplayState *state,
       logical_monitor =
         cc_display_logical_monitor_new_from_variant (state,
                                                      logical_monitor_variant);
+      g_variant_unref (logical_monitor_variant);
       if (!logical_monitor)
         continue;
 
@@ -547,246 +940,1745 @@ get_max_screen_size_from_variant (CcDisplayState *state,
                  &state->max_screen_height);
 }
 
-static bool
-get_current_state (CcDisplayState *state,
-                   CcDbusDisplayConfig *proxy,
-                   GError **error)
+static void
+add_monitor_index_entry (CcDisplayState *state,
+                         const char *selector,
+                         CcDisplayMonitor *monitor)
 {
-  unsigned int serial;
-  GVariant *monitors_variant;
-  GVariant *logical_monitors_variant;
-  GVariant *max_screen_size_variant;
-  GVariant *properties_variant;
+  GPtrArray *monitors;
 
-  if (!cc_dbus_display_config_call_get_current_state_sync (proxy,
-                                                           &serial,
-                                                           &monitors_variant,
-                                                           &logical_monitors_variant,
-                                                           &properties_variant,
-                                                           NULL,
-                                                           error))
-    return false;
+  monitors = g_hash_table_lookup (state->monitor_index, selector);
+  if (!monitors)
+    {
+      monitors = g_ptr_array_new ();
+      g_hash_table_insert (state->monitor_index, g_strdup (selector), monitors);
+    }
 
-  state->serial = serial;
+  if (!g_ptr_array_find (monitors, monitor, NULL))
+    g_ptr_array_add (monitors, monitor);
+}
 
-  get_monitors_from_variant (state, monitors_variant);
-  get_logical_monitors_from_variant (state, logical_monitors_variant);
+/*
+ * Indexes the monitors by every exact selector cc_display_state_lookup_monitor()
+ * accepts: connector, identity, display name and "builtin". Names shared by
+ * several monitors, such as the display name of two identical models, map to
+ * all of them.
+ */
+static void
+build_monitor_index (CcDisplayState *state)
+{
+  GList *l;
 
-  max_screen_size_variant = g_variant_lookup_value (properties_variant,
-                                                    "max-screen-size",
-                                                    G_VARIANT_TYPE ("(ii)"));
-  if (max_screen_size_variant)
-    get_max_screen_size_from_variant (state, max_screen_size_variant);
+  state->monitor_index =
+    g_hash_table_new_full (g_str_hash, g_str_equal,
+                           g_free, (GDestroyNotify) g_ptr_array_unref);
 
-  return true;
+  for (l = state->monitors; l; l = l->next)
+    {
+      CcDisplayMonitor *monitor = l->data;
+      g_autofree char *identity = NULL;
+
+      identity = cc_display_monitor_dup_identity (monitor);
+
+      add_monitor_index_entry (state, monitor->connector, monitor);
+      add_monitor_index_entry (state, identity, monitor);
+      if (monitor->display_name)
+        add_monitor_index_entry (state, monitor->display_name, monitor);
+      if (monitor->is_builtin)
+        add_monitor_index_entry (state, "builtin", monitor);
+    }
 }
 
+/*
+ * Also moves the supported scales of every mode into the one buffer of the
+ * table.
+ */
 static void
-cc_display_monitor_free (CcDisplayMonitor *monitor)
+build_mode_table (CcDisplayState *state)
 {
-  g_list_free_full (monitor->modes, (GDestroyNotify) cc_display_mode_free);
-  g_free (monitor);
-}
+  CcDisplayModeTable *table = &state->mode_table;
+  unsigned int n_rows = 0;
+  unsigned int n_scales = 0;
+  unsigned int row = 0;
+  GList *l, *k;
 
-CcDisplayState *
-cc_display_state_new_current (CcDbusDisplayConfig *proxy,
-                              GError **error)
-{
-  g_autofree CcDisplayState *state = NULL;
+  for (l = state->monitors; l; l = l->next)
+    {
+      CcDisplayMonitor *monitor = l->data;
 
-  state = g_new0 (CcDisplayState, 1);
+      for (k = monitor->modes; k; k = k->next)
+        {
+          CcDisplayMode *mode = k->data;
 
-  if (!get_current_state (state, proxy, error))
-    return NULL;
+          n_rows++;
+          n_scales += mode->n_supported_scales;
+        }
+    }
 
-  return g_steal_pointer (&state);
-}
+  *table = (CcDisplayModeTable) {
+    .n_rows = n_rows,
+    .modes = g_new (CcDisplayMode *, n_rows),
+    .monitors = g_new (CcDisplayMonitor *, n_rows),
+    .widths = g_new (int32_t, n_rows),
+    .heights = g_new (int32_t, n_rows),
+    .refresh_rates = g_new (double, n_rows),
+    .preferred_scales = g_new (double, n_rows),
+    .flags = g_new (uint32_t, n_rows),
+    .scales_offsets = g_new (uint32_t, n_rows),
+    .n_scales = g_new (uint32_t, n_rows),
+    .scales = g_new (double, n_scales),
+  };
 
-void
-cc_display_state_free (CcDisplayState *state)
-{
-  g_list_free_full (state->logical_monitors,
-                    (GDestroyNotify) cc_display_logical_monitor_free);
-  g_list_free_full (state->monitors,
-                    (GDestroyNotify) cc_display_monitor_free);
-  g_free (state);
-}
+  n_scales = 0;
+  for (l = state->monitors; l; l = l->next)
+    {
+      CcDisplayMonitor *monitor = l->data;
 
-double *
-cc_display_mode_get_supported_scales (CcDisplayMode *mode,
-                                      int           *n_supported_scales)
-{
-  *n_supported_scales = mode->n_supported_scales;
-  return g_memdup2 (mode->supported_scales,
-                    sizeof (double) * mode->n_supported_scales);
+      monitor->first_mode_row = row;
+      for (k = monitor->modes; k; k = k->next)
+        {
+          CcDisplayMode *mode = k->data;
+
+          table->modes[row] = mode;
+          table->monitors[row] = monitor;
+          table->widths[row] = mode->resolution_width;
+          table->heights[row] = mode->resolution_height;
+          table->refresh_rates[row] = mode->refresh_rate;
+          table->preferred_scales[row] = mode->preferred_scale;
+          table->flags[row] = mode->flags;
+          table->scales_offsets[row] = n_scales;
+          table->n_scales[row] = mode->n_supported_scales;
+
+          if (mode->n_supported_scales > 0)
+            memcpy (&table->scales[n_scales], mode->supported_scales,
+                    mode->n_supported_scales * sizeof (double));
+          g_free (mode->supported_scales);
+          mode->supported_scales = &table->scales[n_scales];
+
+          n_scales += mode->n_supported_scales;
+          row++;
+        }
+      monitor->n_mode_rows = row - monitor->first_mode_row;
+    }
 }
 
-CcDisplayMonitor *
-cc_display_monitor_config_get_monitor (CcDisplayMonitorConfig *monitor_config)
+static void
+clear_mode_table (CcDisplayModeTable *table)
 {
-  return monitor_config->monitor;
+  g_free (table->modes);
+  g_free (table->monitors);
+  g_free (table->widths);
+  g_free (table->heights);
+  g_free (table->refresh_rates);
+  g_free (table->preferred_scales);
+  g_free (table->flags);
+  g_free (table->scales_offsets);
+  g_free (table->n_scales);
+  g_free (table->scales);
 }
 
-CcDisplayMode *
-cc_display_monitor_config_get_mode (CcDisplayMonitorConfig *monitor_config)
+static int
+compare_ints (const void *a,
+              const void *b)
 {
-  return monitor_config->mode;
-}
+  int value_a = *(const int *) a;
+  int value_b = *(const int *) b;
 
-void
-cc_display_monitor_config_set_mode (CcDisplayMonitorConfig *monitor_config,
-                                    CcDisplayMode *mode)
-{
-  monitor_config->mode = mode;
+  return (value_a > value_b) - (value_a < value_b);
 }
 
-CcDisplayLogicalMonitorConfig *
-cc_display_logical_monitor_config_new (void)
+/* Sorts @values and drops duplicates, returning how many are left */
+static unsigned int
+sort_unique (int *values,
+             unsigned int n_values)
 {
-  return g_new0 (CcDisplayLogicalMonitorConfig, 1);
-}
+  unsigned int n_unique = 0;
+  unsigned int i;
 
-void
-cc_display_logical_monitor_config_set_position (CcDisplayLogicalMonitorConfig *logical_monitor_config,
-                                                int x,
-                                                int y)
-{
-  logical_monitor_config->x = x;
-  logical_monitor_config->y = y;
+  qsort (values, n_values, sizeof (int), compare_ints);
+  for (i = 0; i < n_values; i++)
+    {
+      if (n_unique == 0 || values[i] != values[n_unique - 1])
+        values[n_unique++] = values[i];
+    }
+
+  return n_unique;
 }
 
-void
-cc_display_logical_monitor_config_set_scale (CcDisplayLogicalMonitorConfig *logical_monitor_config,
-                                             double scale)
+/* Returns the index of the last of the sorted @lines <= @value, or -1 */
+static int
+find_grid_line (const int *lines,
+                unsigned int n_lines,
+                int value)
 {
-  logical_monitor_config->scale = scale;
-}
+  unsigned int low = 0;
+  unsigned int high = n_lines;
 
-void
-cc_display_logical_monitor_config_set_transform (CcDisplayLogicalMonitorConfig *logical_monitor_config,
-                                                 CcDisplayTransform             transform)
+  while (low < high)
+    {
+      unsigned int middle = low + (high - low) / 2;
+
+      if (lines[middle] <= value)
+        low = middle + 1;
+      else
+        high = middle;
+    }
+
+  return (int) low - 1;
+}
+
+static void
+build_spatial_index (CcDisplayState *state)
 {
-  logical_monitor_config->transform = transform;
+  CcDisplaySpatialIndex *grid = &state->spatial_index;
+  unsigned int n_columns;
+  unsigned int i;
+  GList *l;
+
+  grid->n_rects = g_list_length (state->logical_monitors);
+  if (grid->n_rects == 0)
+    return;
+
+  grid->logical_monitors = g_new (CcDisplayLogicalMonitor *, grid->n_rects);
+  grid->rects = g_new (cairo_rectangle_int_t, grid->n_rects);
+  grid->xs = g_new (int, 2 * grid->n_rects);
+  grid->ys = g_new (int, 2 * grid->n_rects);
+
+  for (l = state->logical_monitors, i = 0; l; l = l->next, i++)
+    {
+      cairo_rectangle_int_t *rect = &grid->rects[i];
+
+      grid->logical_monitors[i] = l->data;
+      cc_display_logical_monitor_calculate_rect (l->data, state->layout_mode,
+                                                 rect);
+
+      grid->xs[2 * i] = rect->x;
+      grid->xs[2 * i + 1] = rect->x + rect->width;
+      grid->ys[2 * i] = rect->y;
+      grid->ys[2 * i + 1] = rect->y + rect->height;
+    }
+
+  grid->n_xs = sort_unique (grid->xs, 2 * grid->n_rects);
+  grid->n_ys = sort_unique (grid->ys, 2 * grid->n_rects);
+
+  n_columns = grid->n_xs - 1;
+  grid->cells = g_new0 (uint32_t, MAX (n_columns * (grid->n_ys - 1), 1));
+
+  for (i = 0; i < grid->n_rects; i++)
+    {
+      const cairo_rectangle_int_t *rect = &grid->rects[i];
+      int column_start, column_end, row_start, row_end;
+      int row, column;
+
+      column_start = find_grid_line (grid->xs, grid->n_xs, rect->x);
+      column_end = find_grid_line (grid->xs, grid->n_xs,
+                                   rect->x + rect->width);
+      row_start = find_grid_line (grid->ys, grid->n_ys, rect->y);
+      row_end = find_grid_line (grid->ys, grid->n_ys,
+                                rect->y + rect->height);
+
+      for (row = row_start; row < row_end; row++)
+        {
+          for (column = column_start; column < column_end; column++)
+            {
+              uint32_t *cell = &grid->cells[row * n_columns + column];
+
+              if (*cell == 0)
+                *cell = i + 1;
+            }
+        }
+    }
 }
 
-void
-cc_display_logical_monitor_config_set_is_primary (CcDisplayLogicalMonitorConfig *logical_monitor_config,
-                                                  bool is_primary)
+static void
+clear_spatial_index (CcDisplaySpatialIndex *grid)
 {
-  logical_monitor_config->is_primary = is_primary;
+  g_free (grid->logical_monitors);
+  g_free (grid->rects);
+  g_free (grid->xs);
+  g_free (grid->ys);
+  g_free (grid->cells);
 }
 
-void
-cc_display_logical_monitor_config_add_monitor (CcDisplayLogicalMonitorConfig *logical_monitor_config,
-                                               CcDisplayMonitor *monitor,
-                                               CcDisplayMode *mode)
+static bool
+get_state_from_variant (CcDisplayState *state,
+                        GVariant *state_variant,
+                        GError **error)
 {
-  CcDisplayMonitorConfig *monitor_config;
+  unsigned int serial;
+  g_autoptr(GVariant) monitors_variant = NULL;
+  g_autoptr(GVariant) logical_monitors_variant = NULL;
+  g_autoptr(GVariant) max_screen_size_variant = NULL;
+  g_autoptr(GVariant) properties_variant = NULL;
 
-  monitor_config = g_new0 (CcDisplayMonitorConfig, 1);
-  *monitor_config = (CcDisplayMonitorConfig) {
-    .monitor = monitor,
-    .mode = mode
-  };
-  fprintf(stderr, ":::: %s:%d %s() - \n", __FILE__, __LINE__, __func__);
-  logical_monitor_config->monitor_configs =
-    g_list_append (logical_monitor_config->monitor_configs, monitor_config);
+  if (!g_variant_is_of_type (state_variant,
+                             G_VARIANT_TYPE (CC_DISPLAY_STATE_FORMAT)))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Unexpected display state type '%s'",
+                   g_variant_get_type_string (state_variant));
+      return false;
+    }
+
+  g_variant_get (state_variant, "(u@*@*@a{sv})",
+                 &serial,
+                 &monitors_variant,
+                 &logical_monitors_variant,
+                 &properties_variant);
+
+  state->serial = serial;
+
+  get_monitors_from_variant (state, monitors_variant);
+  build_mode_table (state);
+  get_logical_monitors_from_variant (state, logical_monitors_variant);
+  build_monitor_index (state);
+
+  max_screen_size_variant = g_variant_lookup_value (properties_variant,
+                                                    "max-screen-size",
+                                                    G_VARIANT_TYPE ("(ii)"));
+  if (max_screen_size_variant)
+    get_max_screen_size_from_variant (state, max_screen_size_variant);
+
+  if (!g_variant_lookup (properties_variant, "layout-mode", "u",
+                         &state->layout_mode))
+    state->layout_mode = CC_DISPLAY_LAYOUT_MODE_LOGICAL;
+
+  if (!g_variant_lookup (properties_variant, "supports-changing-layout-mode",
+                         "b", &state->supports_changing_layout_mode))
+    state->supports_changing_layout_mode = FALSE;
+
+  build_spatial_index (state);
+
+  return true;
 }
 
-bool
-cc_display_logical_monitor_config_is_primary (CcDisplayLogicalMonitorConfig *logical_monitor_config)
+static void
+cc_display_monitor_free (CcDisplayMonitor *monitor)
 {
-  return logical_monitor_config->is_primary;
+  g_ptr_array_unref (monitor->ranked_modes);
+  g_list_free_full (monitor->modes, (GDestroyNotify) cc_display_mode_free);
+  g_free (monitor->display_name);
+  g_free (monitor);
 }
 
-double
-cc_display_logical_monitor_config_get_scale (CcDisplayLogicalMonitorConfig *logical_monitor_config)
+static G_GNUC_UNUSED unsigned int
+count_modes (CcDisplayState *state)
 {
-  return logical_monitor_config->scale;
+  unsigned int n_modes = 0;
+  GList *l;
+
+  for (l = state->monitors; l; l = l->next)
+    {
+      CcDisplayMonitor *monitor = l->data;
+
+      n_modes += g_list_length (monitor->modes);
+    }
+
+  return n_modes;
 }
 
-CcDisplayTransform
-cc_display_logical_monitor_config_get_transform (CcDisplayLogicalMonitorConfig *logical_monitor_config)
+CcDisplayState *
+cc_display_state_new_from_variant (GVariant *state_variant,
+                                   GError **error)
 {
-  return logical_monitor_config->transform;
+  g_autofree CcDisplayState *state = NULL;
+  GMC_TRACE_BEGIN (state_new_from_variant);
+
+  state = g_new0 (CcDisplayState, 1);
+  g_atomic_ref_count_init (&state->ref_count);
+
+  if (!get_state_from_variant (state, state_variant, error))
+    return NULL;
+
+  GMC_TRACE_END (state_new_from_variant,
+                 g_list_length (state->monitors), count_modes (state),
+                 g_variant_get_size (state_variant));
+
+  return g_steal_pointer (&state);
 }
 
-void
-cc_display_logical_monitor_config_get_position (CcDisplayLogicalMonitorConfig *logical_monitor_config,
-                                                int *x,
-                                                int *y)
+/*
+ * Maps a GetCurrentState reply previously written with
+ * cc_display_state_variant_save_to_file(). The returned variant references
+ * the mapped file directly instead of copying it.
+ */
+GVariant *
+cc_display_state_variant_new_from_file (const char *path,
+                                        GError **error)
 {
-  *x = logical_monitor_config->x;
-  *y = logical_monitor_config->y;
+  g_autoptr(GMappedFile) mapped_file = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+
+  mapped_file = g_mapped_file_new (path, FALSE, error);
+  if (!mapped_file)
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (mapped_file);
+
+  return g_variant_ref_sink (g_variant_new_from_bytes (G_VARIANT_TYPE (CC_DISPLAY_STATE_FORMAT),
+                                                       bytes,
+                                                       FALSE));
 }
 
-void
-cc_display_logical_monitor_config_calculate_layout (CcDisplayLogicalMonitorConfig *logical_monitor_config,
-                                                    cairo_rectangle_int_t *layout)
+gboolean
+cc_display_state_variant_save_to_file (GVariant *state_variant,
+                                       const char *path,
+                                       GError **error)
 {
-  CcDisplayMonitorConfig *monitor_config;
+  g_autoptr(GBytes) bytes = NULL;
 
-  g_return_if_fail (logical_monitor_config->monitor_configs);
+  if (!g_variant_is_of_type (state_variant,
+                             G_VARIANT_TYPE (CC_DISPLAY_STATE_FORMAT)))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                   "Unexpected display state type '%s'",
+                   g_variant_get_type_string (state_variant));
+      return FALSE;
+    }
 
-  monitor_config = logical_monitor_config->monitor_configs->data;
+  bytes = g_variant_get_data_as_bytes (state_variant);
 
-  *layout = (cairo_rectangle_int_t) {
-    .x = logical_monitor_config->x,
-    .y = logical_monitor_config->y,
-    .width = monitor_config->mode->resolution_width,
-    .height = monitor_config->mode->resolution_height
-  };
+  return g_file_set_contents (path,
+                              g_bytes_get_data (bytes, NULL),
+                              g_bytes_get_size (bytes),
+                              error);
 }
 
-GList *
-cc_display_logical_monitor_config_get_monitor_configs (CcDisplayLogicalMonitorConfig *logical_monitor_config)
+CcDisplayState *
+cc_display_state_new_current (CcDbusDisplayConfig *proxy,
+                              GError **error)
 {
-  return logical_monitor_config->monitor_configs;
+  g_autoptr(GVariant) state_variant = NULL;
+
+  state_variant = g_dbus_proxy_call_sync (G_DBUS_PROXY (proxy),
+                                          "GetCurrentState",
+                                          NULL,
+                                          G_DBUS_CALL_FLAGS_NONE,
+                                          -1,
+                                          NULL,
+                                          error);
+  if (!state_variant)
+    return NULL;
+
+  return cc_display_state_new_from_variant (state_variant, error);
 }
 
-CcDisplayConfig *
-cc_display_config_new (void)
+CcDisplayState *
+cc_display_state_ref (CcDisplayState *state)
 {
-  CcDisplayConfig *config;
+  g_atomic_ref_count_inc (&state->ref_count);
 
-  config = g_new0 (CcDisplayConfig, 1);
-
-  return config;
+  return state;
 }
 
 void
-cc_display_config_set_layout_mode (CcDisplayConfig *config,
-                                   CcDisplayLayoutMode layout_mode)
+cc_display_state_unref (CcDisplayState *state)
 {
-  config->layout_mode_set = TRUE;
-  config->layout_mode = layout_mode;
+  if (!g_atomic_ref_count_dec (&state->ref_count))
+    return;
+
+  g_list_free_full (state->logical_monitors,
+                    (GDestroyNotify) cc_display_logical_monitor_free);
+  g_list_free_full (state->monitors,
+                    (GDestroyNotify) cc_display_monitor_free);
+  g_clear_pointer (&state->monitor_index, g_hash_table_destroy);
+  clear_mode_table (&state->mode_table);
+  clear_spatial_index (&state->spatial_index);
+  g_free (state);
+}
+
+unsigned int
+cc_display_state_get_n_modes (CcDisplayState *state)
+{
+  return state->mode_table.n_rows;
+}
+
+CcDisplayMode *
+cc_display_state_get_mode (CcDisplayState *state,
+                           unsigned int row)
+{
+  g_return_val_if_fail (row < state->mode_table.n_rows, NULL);
+
+  return state->mode_table.modes[row];
+}
+
+CcDisplayMonitor *
+cc_display_state_get_mode_monitor (CcDisplayState *state,
+                                   unsigned int row)
+{
+  g_return_val_if_fail (row < state->mode_table.n_rows, NULL);
+
+  return state->mode_table.monitors[row];
+}
+
+#define MODE_FILTER_BLOCK_SIZE 256
+#define MODE_FILTER_SCALE_TOLERANCE 0.01
+
+static bool
+mode_row_supports_scale (const CcDisplayModeTable *table,
+                         unsigned int row,
+                         double scale)
+{
+  const double *scales = &table->scales[table->scales_offsets[row]];
+  unsigned int i;
+
+  for (i = 0; i < table->n_scales[row]; i++)
+    {
+      if (fabs (scales[i] - scale) < MODE_FILTER_SCALE_TOLERANCE)
+        return true;
+    }
+
+  return false;
 }
 
+/*
+ * Same tolerance as cc_display_state_filter_modes(), reading the scales in
+ * place rather than copying them like cc_display_mode_get_supported_scales().
+ */
 gboolean
-cc_display_config_get_layout_mode (CcDisplayConfig *config,
-                                   CcDisplayLayoutMode *layout_mode)
+cc_display_mode_supports_scale (CcDisplayMode *mode,
+                                double scale)
 {
-  if (config->layout_mode_set)
+  int i;
+
+  for (i = 0; i < mode->n_supported_scales; i++)
     {
-      *layout_mode = config->layout_mode;
-      return TRUE;
+      if (fabs (mode->supported_scales[i] - scale) < MODE_FILTER_SCALE_TOLERANCE)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/*
+ * Stores the rows of the modes matching @filter in @rows, which must have
+ * room for cc_display_state_get_n_modes() entries, and returns their number.
+ *
+ * The columns are scanned in blocks: a branch free pass over the numeric
+ * columns marks candidate rows, and only those have their supported scales
+ * checked. Optimizing compilers turn that pass into SIMD code, so this only
+ * pays off fully in optimized builds, not in the default -O0 debug build.
+ */
+unsigned int
+cc_display_state_filter_modes (CcDisplayState *state,
+                               const CcDisplayModeFilter *filter,
+                               unsigned int *rows)
+{
+  const CcDisplayModeTable *table = &state->mode_table;
+  const int32_t min_width = filter->min_width;
+  const int32_t min_height = filter->min_height;
+  const double min_refresh_rate = filter->min_refresh_rate;
+  const uint32_t excluded_flags =
+    filter->exclude_interlaced ? CC_DBUS_DISPLAY_CONFIG_MODE_FLAGS_INTERLACED : 0;
+  unsigned int first_row, end_row;
+  unsigned int block;
+  unsigned int n_matches = 0;
+
+  if (filter->monitor)
+    {
+      g_return_val_if_fail (filter->monitor->state == state, 0);
+
+      first_row = filter->monitor->first_mode_row;
+      end_row = first_row + filter->monitor->n_mode_rows;
     }
   else
     {
-      return FALSE;
+      first_row = 0;
+      end_row = table->n_rows;
+    }
+
+  for (block = first_row; block < end_row; block += MODE_FILTER_BLOCK_SIZE)
+    {
+      const int32_t *widths = &table->widths[block];
+      const int32_t *heights = &table->heights[block];
+      const double *refresh_rates = &table->refresh_rates[block];
+      const uint32_t *flags = &table->flags[block];
+      uint8_t candidates[MODE_FILTER_BLOCK_SIZE];
+      unsigned int n_block_rows;
+      unsigned int i;
+
+      n_block_rows = MIN (MODE_FILTER_BLOCK_SIZE, end_row - block);
+
+      for (i = 0; i < n_block_rows; i++)
+        {
+          candidates[i] = ((widths[i] >= min_width) &
+                           (heights[i] >= min_height) &
+                           (refresh_rates[i] >= min_refresh_rate) &
+                           ((flags[i] & excluded_flags) == 0));
+        }
+
+      for (i = 0; i < n_block_rows; i++)
+        {
+          if (!candidates[i])
+            continue;
+
+          if (filter->scale > 0 &&
+              !mode_row_supports_scale (table, block + i, filter->scale))
+            continue;
+
+          rows[n_matches++] = block + i;
+        }
     }
+
+  return n_matches;
 }
 
 void
-cc_display_config_add_logical_monitor (CcDisplayConfig *config,
-                                       CcDisplayLogicalMonitorConfig *logical_monitor_config)
+cc_display_state_free (CcDisplayState *state)
 {
-  config->logical_monitor_configs =
-    g_list_append (config->logical_monitor_configs, logical_monitor_config);
+  cc_display_state_unref (state);
 }
 
-GList *
-cc_display_config_get_logical_logical_monitor_configs (CcDisplayConfig *config)
+static gboolean
+monitor_matches_pattern (CcDisplayMonitor *monitor,
+                         GPatternSpec *pattern)
 {
-  return config->logical_monitor_configs;
+  g_autofree char *identity = NULL;
+
+  identity = cc_display_monitor_dup_identity (monitor);
+
+  return (g_pattern_spec_match_string (pattern, monitor->connector) ||
+          g_pattern_spec_match_string (pattern, identity) ||
+          (monitor->display_name &&
+           g_pattern_spec_match_string (pattern, monitor->display_name)));
+}
+
+unsigned int
+cc_display_state_get_n_logical_monitors (CcDisplayState *state)
+{
+  return state->spatial_index.n_rects;
+}
+
+/*
+ * Returns the logical monitor whose area, as calculated by
+ * cc_display_logical_monitor_calculate_rect() in the layout mode of @state,
+ * contains the point @x, @y, or NULL if none does.
+ */
+CcDisplayLogicalMonitor *
+cc_display_state_lookup_logical_monitor_at (CcDisplayState *state,
+                                            int x,
+                                            int y)
+{
+  const CcDisplaySpatialIndex *grid = &state->spatial_index;
+  int column, row;
+  uint32_t cell;
+
+  column = find_grid_line (grid->xs, grid->n_xs, x);
+  row = find_grid_line (grid->ys, grid->n_ys, y);
+  if (column < 0 || column >= (int) grid->n_xs - 1 ||
+      row < 0 || row >= (int) grid->n_ys - 1)
+    return NULL;
+
+  cell = grid->cells[row * (grid->n_xs - 1) + column];
+
+  return cell ? grid->logical_monitors[cell - 1] : NULL;
+}
+
+/*
+ * Stores the logical monitors intersecting @rect in @logical_monitors, which
+ * must have room for cc_display_state_get_n_logical_monitors() entries, in
+ * the order of cc_display_state_get_logical_monitors(), and returns their
+ * number.
+ */
+unsigned int
+cc_display_state_find_logical_monitors_in_rect (CcDisplayState *state,
+                                                const cairo_rectangle_int_t *rect,
+                                                CcDisplayLogicalMonitor **logical_monitors)
+{
+  const CcDisplaySpatialIndex *grid = &state->spatial_index;
+  int n_columns, n_rows;
+  int column_start, column_end, row_start, row_end;
+  int row, column;
+  unsigned int n_found = 0;
+  unsigned int i;
+
+  if (grid->n_rects == 0 || rect->width <= 0 || rect->height <= 0)
+    return 0;
+
+  n_columns = grid->n_xs - 1;
+  n_rows = grid->n_ys - 1;
+
+  column_start = MAX (find_grid_line (grid->xs, grid->n_xs, rect->x), 0);
+  column_end = MIN (find_grid_line (grid->xs, grid->n_xs,
+                                    rect->x + rect->width - 1) + 1,
+                    n_columns);
+  row_start = MAX (find_grid_line (grid->ys, grid->n_ys, rect->y), 0);
+  row_end = MIN (find_grid_line (grid->ys, grid->n_ys,
+                                 rect->y + rect->height - 1) + 1,
+                 n_rows);
+
+  /* Mark the hits in the slots of their index, then compact in order */
+  for (i = 0; i < grid->n_rects; i++)
+    logical_monitors[i] = NULL;
+
+  for (row = row_start; row < row_end; row++)
+    {
+      for (column = column_start; column < column_end; column++)
+        {
+          uint32_t cell = grid->cells[row * n_columns + column];
+
+          if (cell)
+            logical_monitors[cell - 1] = grid->logical_monitors[cell - 1];
+        }
+    }
+
+  for (i = 0; i < grid->n_rects; i++)
+    {
+      if (logical_monitors[i])
+        logical_monitors[n_found++] = logical_monitors[i];
+    }
+
+  return n_found;
+}
+
+/*
+ * Resolves @selector to a single monitor. A selector is a connector (DP-1),
+ * an identity as returned by cc_display_monitor_dup_identity(), a display
+ * name, "builtin", or a glob pattern using '*' and '?' matched against any of
+ * those. It is an error if nothing or more than one monitor matches.
+ */
+CcDisplayMonitor *
+cc_display_state_lookup_monitor (CcDisplayState *state,
+                                 const char *selector,
+                                 GError **error)
+{
+  g_autoptr(GPtrArray) matches = NULL;
+  GPtrArray *monitors;
+
+  monitors = g_hash_table_lookup (state->monitor_index, selector);
+  if (monitors)
+    {
+      matches = g_ptr_array_ref (monitors);
+    }
+  else if (strpbrk (selector, "*?"))
+    {
+      g_autoptr(GPatternSpec) pattern = NULL;
+      GList *l;
+
+      pattern = g_pattern_spec_new (selector);
+      matches = g_ptr_array_new ();
+      for (l = state->monitors; l; l = l->next)
+        {
+          if (monitor_matches_pattern (l->data, pattern))
+            g_ptr_array_add (matches, l->data);
+        }
+    }
+
+  if (!matches || matches->len == 0)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                   "No monitor matches '%s'", selector);
+      return NULL;
+    }
+
+  if (matches->len > 1)
+    {
+      g_autoptr(GString) connectors = NULL;
+      unsigned int i;
+
+      connectors = g_string_new (NULL);
+      for (i = 0; i < matches->len; i++)
+        {
+          CcDisplayMonitor *monitor = g_ptr_array_index (matches, i);
+
+          g_string_append_printf (connectors, "%s%s",
+                                  i > 0 ? ", " : "", monitor->connector);
+        }
+
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "'%s' matches several monitors: %s",
+                   selector, connectors->str);
+      return NULL;
+    }
+
+  return g_ptr_array_index (matches, 0);
+}
+
+double *
+cc_display_mode_get_supported_scales (CcDisplayMode *mode,
+                                      int           *n_supported_scales)
+{
+  *n_supported_scales = mode->n_supported_scales;
+  return g_memdup2 (mode->supported_scales,
+                    sizeof (double) * mode->n_supported_scales);
+}
+
+CcDisplayMonitor *
+cc_display_monitor_config_get_monitor (CcDisplayMonitorConfig *monitor_config)
+{
+  return monitor_config->monitor;
+}
+
+CcDisplayMode *
+cc_display_monitor_config_get_mode (CcDisplayMonitorConfig *monitor_config)
+{
+  return monitor_config->mode;
+}
+
+void
+cc_display_monitor_config_set_mode (CcDisplayMonitorConfig *monitor_config,
+                                    CcDisplayMode *mode)
+{
+  monitor_config->mode = mode;
+}
+
+CcDisplayLogicalMonitorConfig *
+cc_display_logical_monitor_config_new (void)
+{
+  return g_new0 (CcDisplayLogicalMonitorConfig, 1);
+}
+
+static CcDisplayMonitorConfig *
+cc_display_monitor_config_new (CcDisplayMonitor *monitor,
+                               CcDisplayMode *mode)
+{
+  CcDisplayMonitorConfig *monitor_config;
+
+  monitor_config = g_new0 (CcDisplayMonitorConfig, 1);
+  *monitor_config = (CcDisplayMonitorConfig) {
+    .state = cc_display_state_ref (monitor->state),
+    .monitor = monitor,
+    .mode = mode
+  };
+
+  return monitor_config;
+}
+
+static void
+cc_display_monitor_config_free (CcDisplayMonitorConfig *monitor_config)
+{
+  cc_display_state_unref (monitor_config->state);
+  g_free (monitor_config);
+}
+
+void
+cc_display_logical_monitor_config_free (CcDisplayLogicalMonitorConfig *logical_monitor_config)
+{
+  g_list_free_full (logical_monitor_config->monitor_configs,
+                    (GDestroyNotify) cc_display_monitor_config_free);
+  g_free (logical_monitor_config);
+}
+
+void
+cc_display_logical_monitor_config_set_position (CcDisplayLogicalMonitorConfig *logical_monitor_config,
+                                                int x,
+                                                int y)
+{
+  logical_monitor_config->x = x;
+  logical_monitor_config->y = y;
+}
+
+void
+cc_display_logical_monitor_config_set_scale (CcDisplayLogicalMonitorConfig *logical_monitor_config,
+                                             double scale)
+{
+  logical_monitor_config->scale = scale;
+}
+
+void
+cc_display_logical_monitor_config_set_transform (CcDisplayLogicalMonitorConfig *logical_monitor_config,
+                                                 CcDisplayTransform             transform)
+{
+  logical_monitor_config->transform = transform;
+}
+
+void
+cc_display_logical_monitor_config_set_is_primary (CcDisplayLogicalMonitorConfig *logical_monitor_config,
+                                                  bool is_primary)
+{
+  logical_monitor_config->is_primary = is_primary;
+}
+
+void
+cc_display_logical_monitor_config_add_monitor (CcDisplayLogicalMonitorConfig *logical_monitor_config,
+                                               CcDisplayMonitor *monitor,
+                                               CcDisplayMode *mode)
+{
+  CcDisplayMonitorConfig *monitor_config;
+
+  monitor_config = cc_display_monitor_config_new (monitor, mode);
+  g_debug ("Adding monitor %s with mode %s to logical monitor",
+           monitor->connector, mode ? mode->id : "(none)");
+  logical_monitor_config->monitor_configs =
+    g_list_append (logical_monitor_config->monitor_configs, monitor_config);
+}
+
+bool
+cc_display_logical_monitor_config_is_primary (CcDisplayLogicalMonitorConfig *logical_monitor_config)
+{
+  return logical_monitor_config->is_primary;
+}
+
+double
+cc_display_logical_monitor_config_get_scale (CcDisplayLogicalMonitorConfig *logical_monitor_config)
+{
+  return logical_monitor_config->scale;
+}
+
+CcDisplayTransform
+cc_display_logical_monitor_config_get_transform (CcDisplayLogicalMonitorConfig *logical_monitor_config)
+{
+  return logical_monitor_config->transform;
+}
+
+void
+cc_display_logical_monitor_config_get_position (CcDisplayLogicalMonitorConfig *logical_monitor_config,
+                                                int *x,
+                                                int *y)
+{
+  *x = logical_monitor_config->x;
+  *y = logical_monitor_config->y;
+}
+
+void
+cc_display_logical_monitor_config_calculate_layout (CcDisplayLogicalMonitorConfig *logical_monitor_config,
+                                                    cairo_rectangle_int_t *layout)
+{
+  CcDisplayMonitorConfig *monitor_config;
+
+  g_return_if_fail (logical_monitor_config->monitor_configs);
+
+  monitor_config = logical_monitor_config->monitor_configs->data;
+
+  *layout = (cairo_rectangle_int_t) {
+    .x = logical_monitor_config->x,
+    .y = logical_monitor_config->y,
+    .width = monitor_config->mode->resolution_width,
+    .height = monitor_config->mode->resolution_height
+  };
+}
+
+/*
+ * Calculates the area @logical_monitor_config covers in the layout, taking
+ * the transform into account and, in the logical layout mode, the scale.
+ */
+void
+cc_display_logical_monitor_config_calculate_rect (CcDisplayLogicalMonitorConfig *logical_monitor_config,
+                                                  CcDisplayLayoutMode layout_mode,
+                                                  cairo_rectangle_int_t *rect)
+{
+  CcDisplayMonitorConfig *monitor_config;
+
+  g_return_if_fail (logical_monitor_config->monitor_configs);
+
+  monitor_config = logical_monitor_config->monitor_configs->data;
+
+  calculate_rect (logical_monitor_config->x,
+                  logical_monitor_config->y,
+                  monitor_config->mode->resolution_width,
+                  monitor_config->mode->resolution_height,
+                  logical_monitor_config->transform,
+                  logical_monitor_config->scale,
+                  layout_mode,
+                  rect);
+}
+
+GList *
+cc_display_logical_monitor_config_get_monitor_configs (CcDisplayLogicalMonitorConfig *logical_monitor_config)
+{
+  return logical_monitor_config->monitor_configs;
+}
+
+CcDisplayConfig *
+cc_display_config_new (void)
+{
+  CcDisplayConfig *config;
+
+  config = g_new0 (CcDisplayConfig, 1);
+
+  return config;
+}
+
+/*
+ * Creates a configuration reproducing the logical monitors of @state with
+ * their current modes.
+ */
+CcDisplayConfig *
+cc_display_config_new_from_state (CcDisplayState *state)
+{
+  CcDisplayConfig *config;
+  GList *l;
+
+  config = cc_display_config_new ();
+
+  for (l = state->logical_monitors; l; l = l->next)
+    {
+      CcDisplayLogicalMonitor *logical_monitor = l->data;
+      CcDisplayLogicalMonitorConfig *logical_monitor_config;
+      GList *k;
+
+      logical_monitor_config = cc_display_logical_monitor_config_new ();
+      *logical_monitor_config = (CcDisplayLogicalMonitorConfig) {
+        .x = logical_monitor->x,
+        .y = logical_monitor->y,
+        .scale = logical_monitor->scale,
+        .transform = logical_monitor->transform,
+        .is_primary = logical_monitor->is_primary
+      };
+
+      for (k = logical_monitor->monitors; k; k = k->next)
+        {
+          CcDisplayMonitor *monitor = k->data;
+          CcDisplayMonitorConfig *monitor_config;
+
+          monitor_config = cc_display_monitor_config_new (monitor,
+                                                          monitor->current_mode);
+          logical_monitor_config->monitor_configs =
+            g_list_append (logical_monitor_config->monitor_configs,
+                           monitor_config);
+        }
+
+      config->logical_monitor_configs =
+        g_list_append (config->logical_monitor_configs,
+                       logical_monitor_config);
+    }
+
+  return config;
+}
+
+void
+cc_display_config_free (CcDisplayConfig *config)
+{
+  g_list_free_full (config->logical_monitor_configs,
+                    (GDestroyNotify) cc_display_logical_monitor_config_free);
+  g_free (config);
+}
+
+void
+cc_display_config_set_layout_mode (CcDisplayConfig *config,
+                                   CcDisplayLayoutMode layout_mode)
+{
+  config->layout_mode_set = TRUE;
+  config->layout_mode = layout_mode;
+}
+
+gboolean
+cc_display_config_get_layout_mode (CcDisplayConfig *config,
+                                   CcDisplayLayoutMode *layout_mode)
+{
+  if (config->layout_mode_set)
+    {
+      *layout_mode = config->layout_mode;
+      return TRUE;
+    }
+  else
+    {
+      return FALSE;
+    }
+}
+
+void
+cc_display_config_add_logical_monitor (CcDisplayConfig *config,
+                                       CcDisplayLogicalMonitorConfig *logical_monitor_config)
+{
+  config->logical_monitor_configs =
+    g_list_append (config->logical_monitor_configs, logical_monitor_config);
+}
+
+GList *
+cc_display_config_get_logical_logical_monitor_configs (CcDisplayConfig *config)
+{
+  return config->logical_monitor_configs;
+}
+
+typedef struct _RefreshRateCandidates
+{
+  CcDisplayMonitorConfig *monitor_config;
+  GPtrArray *modes;
+  unsigned int position;
+  unsigned int best_position;
+} RefreshRateCandidates;
+
+static void
+clear_refresh_rate_candidates (RefreshRateCandidates *candidates)
+{
+  g_ptr_array_unref (candidates->modes);
+}
+
+/*
+ * Collects the modes with the resolution of the configured mode, one per
+ * refresh rate, by increasing refresh rate. The ranking lists them by
+ * decreasing refresh rate with progressive modes first, so walk it backwards
+ * and let progressive modes replace interlaced ones of the same rate.
+ */
+static GPtrArray *
+get_refresh_rate_modes (CcDisplayMonitor *monitor,
+                        CcDisplayMode *configured_mode)
+{
+  GPtrArray *modes;
+  int i;
+
+  modes = g_ptr_array_new ();
+  for (i = monitor->ranked_modes->len - 1; i >= 0; i--)
+    {
+      CcDisplayMode *mode = g_ptr_array_index (monitor->ranked_modes, i);
+      CcDisplayMode *last_mode;
+
+      if (mode->resolution_width != configured_mode->resolution_width ||
+          mode->resolution_height != configured_mode->resolution_height)
+        continue;
+
+      last_mode = modes->len > 0 ? g_ptr_array_index (modes, modes->len - 1)
+                                 : NULL;
+      if (last_mode && last_mode->refresh_rate == mode->refresh_rate)
+        modes->pdata[modes->len - 1] = mode;
+      else
+        g_ptr_array_add (modes, mode);
+    }
+
+  return modes;
+}
+
+/*
+ * Finds the configuration of @monitor in @config, and the logical monitor
+ * configuration holding it in @out_logical_monitor_config. Returns NULL if
+ * @monitor is not part of @config.
+ */
+CcDisplayMonitorConfig *
+cc_display_config_lookup_monitor_config (CcDisplayConfig *config,
+                                         CcDisplayMonitor *monitor,
+                                         CcDisplayLogicalMonitorConfig **out_logical_monitor_config)
+{
+  GList *l;
+
+  for (l = config->logical_monitor_configs; l; l = l->next)
+    {
+      CcDisplayLogicalMonitorConfig *logical_monitor_config = l->data;
+      GList *k;
+
+      for (k = logical_monitor_config->monitor_configs; k; k = k->next)
+        {
+          CcDisplayMonitorConfig *monitor_config = k->data;
+
+          if (monitor_config->monitor != monitor)
+            continue;
+
+          if (out_logical_monitor_config)
+            *out_logical_monitor_config = logical_monitor_config;
+          return monitor_config;
+        }
+    }
+
+  return NULL;
+}
+
+/*
+ * Turns @monitor off by removing it from its logical monitor, and the logical
+ * monitor itself if it becomes empty. If that was the primary one, the first
+ * remaining logical monitor becomes primary.
+ */
+gboolean
+cc_display_config_remove_monitor (CcDisplayConfig *config,
+                                  CcDisplayMonitor *monitor)
+{
+  CcDisplayLogicalMonitorConfig *logical_monitor_config;
+  CcDisplayMonitorConfig *monitor_config;
+
+  monitor_config = cc_display_config_lookup_monitor_config (config, monitor,
+                                                            &logical_monitor_config);
+  if (!monitor_config)
+    return FALSE;
+
+  logical_monitor_config->monitor_configs =
+    g_list_remove (logical_monitor_config->monitor_configs, monitor_config);
+  cc_display_monitor_config_free (monitor_config);
+
+  if (logical_monitor_config->monitor_configs)
+    return TRUE;
+
+  config->logical_monitor_configs =
+    g_list_remove (config->logical_monitor_configs, logical_monitor_config);
+
+  if (logical_monitor_config->is_primary && config->logical_monitor_configs)
+    {
+      CcDisplayLogicalMonitorConfig *first_logical_monitor_config =
+        config->logical_monitor_configs->data;
+
+      first_logical_monitor_config->is_primary = true;
+    }
+
+  cc_display_logical_monitor_config_free (logical_monitor_config);
+
+  return TRUE;
+}
+
+static bool
+logical_monitor_config_is_current (CcDisplayLogicalMonitorConfig *logical_monitor_config,
+                                   CcDisplayLogicalMonitor *logical_monitor)
+{
+  GList *l;
+
+  if (logical_monitor_config->x != logical_monitor->x ||
+      logical_monitor_config->y != logical_monitor->y ||
+      logical_monitor_config->scale != logical_monitor->scale ||
+      logical_monitor_config->transform != logical_monitor->transform ||
+      logical_monitor_config->is_primary != logical_monitor->is_primary)
+    return false;
+
+  if (g_list_length (logical_monitor_config->monitor_configs) !=
+      g_list_length (logical_monitor->monitors))
+    return false;
+
+  for (l = logical_monitor_config->monitor_configs; l; l = l->next)
+    {
+      CcDisplayMonitorConfig *monitor_config = l->data;
+
+      if (!g_list_find (logical_monitor->monitors, monitor_config->monitor) ||
+          monitor_config->mode != monitor_config->monitor->current_mode)
+        return false;
+    }
+
+  return true;
+}
+
+/*
+ * Whether applying @config would leave @state as it is.
+ */
+gboolean
+cc_display_config_is_current (CcDisplayConfig *config,
+                              CcDisplayState *state)
+{
+  GList *l;
+
+  if (config->layout_mode_set && config->layout_mode != state->layout_mode)
+    return FALSE;
+
+  if (g_list_length (config->logical_monitor_configs) !=
+      g_list_length (state->logical_monitors))
+    return FALSE;
+
+  for (l = config->logical_monitor_configs; l; l = l->next)
+    {
+      GList *k;
+
+      for (k = state->logical_monitors; k; k = k->next)
+        {
+          if (logical_monitor_config_is_current (l->data, k->data))
+            break;
+        }
+
+      if (!k)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*
+ * Canonical hashing and equality. Monitors are compared by identity and modes
+ * by id rather than by pointer, so configurations built against different
+ * states of the same monitors compare equal. Lists are compared as sets:
+ * element hashes are mixed and summed, which does not depend on order.
+ */
+
+static guint
+mix_hash (guint hash)
+{
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6b;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35;
+  hash ^= hash >> 16;
+
+  return hash;
+}
+
+static guint
+monitor_identity_hash (CcDisplayMonitor *monitor)
+{
+  guint hash;
+
+  hash = g_direct_hash (monitor->connector);
+  hash = hash * 31 + g_direct_hash (monitor->vendor);
+  hash = hash * 31 + g_direct_hash (monitor->product);
+  hash = hash * 31 + g_direct_hash (monitor->serial);
+
+  return hash;
+}
+
+static gboolean
+monitor_identity_equal (CcDisplayMonitor *monitor,
+                        CcDisplayMonitor *other_monitor)
+{
+  return (monitor == other_monitor ||
+          (monitor->connector == other_monitor->connector &&
+           monitor->vendor == other_monitor->vendor &&
+           monitor->product == other_monitor->product &&
+           monitor->serial == other_monitor->serial));
+}
+
+static guint
+monitor_mode_hash (CcDisplayMonitor *monitor,
+                   CcDisplayMode *mode)
+{
+  guint hash;
+
+  hash = monitor_identity_hash (monitor);
+  if (mode)
+    hash = hash * 31 + g_direct_hash (mode->id);
+
+  return mix_hash (hash);
+}
+
+static gboolean
+mode_equal (CcDisplayMode *mode,
+            CcDisplayMode *other_mode)
+{
+  if (mode == other_mode)
+    return TRUE;
+
+  if (!mode || !other_mode)
+    return FALSE;
+
+  return mode->id == other_mode->id;
+}
+
+static guint
+logical_monitor_properties_hash (int x,
+                                 int y,
+                                 double scale,
+                                 CcDisplayTransform transform,
+                                 bool is_primary)
+{
+  guint hash;
+
+  hash = g_int_hash (&x);
+  hash = hash * 31 + g_int_hash (&y);
+  hash = hash * 31 + g_double_hash (&scale);
+  hash = hash * 31 + transform;
+  hash = hash * 31 + is_primary;
+
+  return hash;
+}
+
+static gboolean
+monitor_configs_contain (GList *monitor_configs,
+                         CcDisplayMonitorConfig *monitor_config)
+{
+  GList *l;
+
+  for (l = monitor_configs; l; l = l->next)
+    {
+      CcDisplayMonitorConfig *other_monitor_config = l->data;
+
+      if (monitor_identity_equal (monitor_config->monitor,
+                                  other_monitor_config->monitor) &&
+          mode_equal (monitor_config->mode, other_monitor_config->mode))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+guint
+cc_display_logical_monitor_config_hash (gconstpointer data)
+{
+  const CcDisplayLogicalMonitorConfig *logical_monitor_config = data;
+  guint monitors_hash = 0;
+  GList *l;
+
+  for (l = logical_monitor_config->monitor_configs; l; l = l->next)
+    {
+      CcDisplayMonitorConfig *monitor_config = l->data;
+
+      monitors_hash += monitor_mode_hash (monitor_config->monitor,
+                                          monitor_config->mode);
+    }
+
+  return mix_hash (logical_monitor_properties_hash (logical_monitor_config->x,
+                                                    logical_monitor_config->y,
+                                                    logical_monitor_config->scale,
+                                                    logical_monitor_config->transform,
+                                                    logical_monitor_config->is_primary) ^
+                   monitors_hash);
+}
+
+/*
+ * A monitor appears at most once in a configuration, so checking that every
+ * monitor of one logical monitor is in the other suffices once the counts
+ * match. The same holds for logical monitors further down.
+ */
+gboolean
+cc_display_logical_monitor_config_equal (gconstpointer a,
+                                         gconstpointer b)
+{
+  const CcDisplayLogicalMonitorConfig *logical_monitor_config = a;
+  const CcDisplayLogicalMonitorConfig *other_logical_monitor_config = b;
+  GList *l;
+
+  if (logical_monitor_config->x != other_logical_monitor_config->x ||
+      logical_monitor_config->y != other_logical_monitor_config->y ||
+      logical_monitor_config->scale != other_logical_monitor_config->scale ||
+      logical_monitor_config->transform != other_logical_monitor_config->transform ||
+      logical_monitor_config->is_primary != other_logical_monitor_config->is_primary)
+    return FALSE;
+
+  if (g_list_length (logical_monitor_config->monitor_configs) !=
+      g_list_length (other_logical_monitor_config->monitor_configs))
+    return FALSE;
+
+  for (l = logical_monitor_config->monitor_configs; l; l = l->next)
+    {
+      if (!monitor_configs_contain (other_logical_monitor_config->monitor_configs,
+                                    l->data))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+guint
+cc_display_config_hash (gconstpointer data)
+{
+  const CcDisplayConfig *config = data;
+  guint hash = 0;
+  GList *l;
+
+  for (l = config->logical_monitor_configs; l; l = l->next)
+    hash += cc_display_logical_monitor_config_hash (l->data);
+
+  if (config->layout_mode_set)
+    hash ^= mix_hash (config->layout_mode + 1);
+
+  return hash;
+}
+
+gboolean
+cc_display_config_equal (gconstpointer a,
+                         gconstpointer b)
+{
+  const CcDisplayConfig *config = a;
+  const CcDisplayConfig *other_config = b;
+  GList *l;
+
+  if (config->layout_mode_set != other_config->layout_mode_set ||
+      (config->layout_mode_set &&
+       config->layout_mode != other_config->layout_mode))
+    return FALSE;
+
+  if (g_list_length (config->logical_monitor_configs) !=
+      g_list_length (other_config->logical_monitor_configs))
+    return FALSE;
+
+  for (l = config->logical_monitor_configs; l; l = l->next)
+    {
+      GList *k;
+
+      for (k = other_config->logical_monitor_configs; k; k = k->next)
+        {
+          if (cc_display_logical_monitor_config_equal (l->data, k->data))
+            break;
+        }
+
+      if (!k)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static guint
+logical_monitor_hash (CcDisplayLogicalMonitor *logical_monitor)
+{
+  guint monitors_hash = 0;
+  GList *l;
+
+  for (l = logical_monitor->monitors; l; l = l->next)
+    {
+      CcDisplayMonitor *monitor = l->data;
+
+      monitors_hash += monitor_mode_hash (monitor, monitor->current_mode);
+    }
+
+  return mix_hash (logical_monitor_properties_hash (logical_monitor->x,
+                                                    logical_monitor->y,
+                                                    logical_monitor->scale,
+                                                    logical_monitor->transform,
+                                                    logical_monitor->is_primary) ^
+                   monitors_hash);
+}
+
+static gboolean
+logical_monitor_has_monitor (CcDisplayLogicalMonitor *logical_monitor,
+                             CcDisplayMonitor *monitor)
+{
+  GList *l;
+
+  for (l = logical_monitor->monitors; l; l = l->next)
+    {
+      CcDisplayMonitor *other_monitor = l->data;
+
+      if (monitor_identity_equal (monitor, other_monitor) &&
+          mode_equal (monitor->current_mode, other_monitor->current_mode))
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+static gboolean
+logical_monitor_equal (CcDisplayLogicalMonitor *logical_monitor,
+                       CcDisplayLogicalMonitor *other_logical_monitor)
+{
+  GList *l;
+
+  if (logical_monitor->x != other_logical_monitor->x ||
+      logical_monitor->y != other_logical_monitor->y ||
+      logical_monitor->scale != other_logical_monitor->scale ||
+      logical_monitor->transform != other_logical_monitor->transform ||
+      logical_monitor->is_primary != other_logical_monitor->is_primary)
+    return FALSE;
+
+  if (g_list_length (logical_monitor->monitors) !=
+      g_list_length (other_logical_monitor->monitors))
+    return FALSE;
+
+  for (l = logical_monitor->monitors; l; l = l->next)
+    {
+      if (!logical_monitor_has_monitor (other_logical_monitor, l->data))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*
+ * Only the logical configuration is taken into account: the layout mode and
+ * the logical monitors with the monitors and modes they use. The serial, the
+ * available modes and disabled monitors are ignored.
+ */
+guint
+cc_display_state_hash (gconstpointer data)
+{
+  const CcDisplayState *state = data;
+  guint hash = 0;
+  GList *l;
+
+  for (l = state->logical_monitors; l; l = l->next)
+    hash += logical_monitor_hash (l->data);
+
+  return hash ^ mix_hash (state->layout_mode + 1);
+}
+
+gboolean
+cc_display_state_equal (gconstpointer a,
+                        gconstpointer b)
+{
+  const CcDisplayState *state = a;
+  const CcDisplayState *other_state = b;
+  GList *l;
+
+  if (state->layout_mode != other_state->layout_mode)
+    return FALSE;
+
+  if (g_list_length (state->logical_monitors) !=
+      g_list_length (other_state->logical_monitors))
+    return FALSE;
+
+  for (l = state->logical_monitors; l; l = l->next)
+    {
+      GList *k;
+
+      for (k = other_state->logical_monitors; k; k = k->next)
+        {
+          if (logical_monitor_equal (l->data, k->data))
+            break;
+        }
+
+      if (!k)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static int
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+  return strcmp (*(const char **) a, *(const char **) b);
+}
+
+static char *
+logical_monitor_config_to_canonical_string (CcDisplayLogicalMonitorConfig *logical_monitor_config)
+{
+  g_autoptr(GPtrArray) monitor_strings = NULL;
+  char scale_str[G_ASCII_DTOSTR_BUF_SIZE];
+  GString *string;
+  unsigned int i;
+  GList *l;
+
+  monitor_strings = g_ptr_array_new_with_free_func (g_free);
+  for (l = logical_monitor_config->monitor_configs; l; l = l->next)
+    {
+      CcDisplayMonitorConfig *monitor_config = l->data;
+
+      g_ptr_array_add (monitor_strings,
+                       g_strdup_printf ("%s=%s",
+                                        monitor_config->monitor->connector,
+                                        monitor_config->mode ?
+                                        monitor_config->mode->id : ""));
+    }
+  g_ptr_array_sort (monitor_strings, compare_strings);
+
+  g_ascii_dtostr (scale_str, sizeof (scale_str), logical_monitor_config->scale);
+  string = g_string_new (NULL);
+  g_string_append_printf (string, "%d,%d,%s,%d,%d:",
+                          logical_monitor_config->x,
+                          logical_monitor_config->y,
+                          scale_str,
+                          logical_monitor_config->transform,
+                          logical_monitor_config->is_primary);
+  for (i = 0; i < monitor_strings->len; i++)
+    g_string_append_printf (string, "[%s]",
+                            (char *) g_ptr_array_index (monitor_strings, i));
+
+  return g_string_free (string, FALSE);
+}
+
+/*
+ * Returns a SHA-256 over a canonical form of @config together with the
+ * identities of the monitors of @state, independent of the order logical
+ * monitors and monitors were added in. Equal fingerprints mean the same
+ * configuration of the same set of monitors.
+ */
+char *
+cc_display_config_get_fingerprint (CcDisplayConfig *config,
+                                   CcDisplayState *state)
+{
+  g_autoptr(GPtrArray) strings = NULL;
+  g_autoptr(GString) canonical = NULL;
+  CcDisplayLayoutMode layout_mode;
+  unsigned int i;
+  GList *l;
+
+  canonical = g_string_new (NULL);
+
+  strings = g_ptr_array_new_with_free_func (g_free);
+  for (l = state->monitors; l; l = l->next)
+    {
+      CcDisplayMonitor *monitor = l->data;
+
+      g_ptr_array_add (strings,
+                       g_strdup_printf ("%s\t%s\t%s\t%s",
+                                        monitor->connector,
+                                        monitor->vendor,
+                                        monitor->product,
+                                        monitor->serial));
+    }
+  g_ptr_array_sort (strings, compare_strings);
+  for (i = 0; i < strings->len; i++)
+    g_string_append_printf (canonical, "%s\n",
+                            (char *) g_ptr_array_index (strings, i));
+
+  layout_mode = config->layout_mode_set ? config->layout_mode
+                                        : state->layout_mode;
+  g_string_append_printf (canonical, "layout-mode=%d\n", layout_mode);
+
+  g_ptr_array_set_size (strings, 0);
+  for (l = config->logical_monitor_configs; l; l = l->next)
+    g_ptr_array_add (strings,
+                     logical_monitor_config_to_canonical_string (l->data));
+  g_ptr_array_sort (strings, compare_strings);
+  for (i = 0; i < strings->len; i++)
+    g_string_append_printf (canonical, "%s\n",
+                            (char *) g_ptr_array_index (strings, i));
+
+  return g_compute_checksum_for_string (G_CHECKSUM_SHA256,
+                                        canonical->str, canonical->len);
+}
+
+/*
+ * Assigns modes, keeping each monitor's configured resolution, so that the
+ * refresh rates of all monitors in @config are as close as possible. This is
+ * the smallest range covering one entry of every sorted per-monitor refresh
+ * rate list, found by repeatedly advancing the list with the lowest current
+ * rate. On ties the higher rates win. Returns the remaining worst-case
+ * deviation in Hz.
+ */
+double
+cc_display_config_sync_refresh_rates (CcDisplayConfig *config)
+{
+  g_autoptr(GArray) candidates_array = NULL;
+  double best_range = DBL_MAX;
+  GList *l;
+  unsigned int i;
+
+  candidates_array = g_array_new (FALSE, FALSE, sizeof (RefreshRateCandidates));
+  g_array_set_clear_func (candidates_array,
+                          (GDestroyNotify) clear_refresh_rate_candidates);
+
+  for (l = config->logical_monitor_configs; l; l = l->next)
+    {
+      CcDisplayLogicalMonitorConfig *logical_monitor_config = l->data;
+      GList *k;
+
+      for (k = logical_monitor_config->monitor_configs; k; k = k->next)
+        {
+          CcDisplayMonitorConfig *monitor_config = k->data;
+          RefreshRateCandidates candidates;
+
+          if (!monitor_config->mode)
+            continue;
+
+          candidates = (RefreshRateCandidates) {
+            .monitor_config = monitor_config,
+            .modes = get_refresh_rate_modes (monitor_config->monitor,
+                                             monitor_config->mode),
+          };
+          g_array_append_val (candidates_array, candidates);
+        }
+    }
+
+  if (candidates_array->len < 2)
+    return 0.0;
+
+  while (true)
+    {
+      RefreshRateCandidates *lowest = NULL;
+      double min_rate = DBL_MAX, max_rate = 0.0;
+
+      for (i = 0; i < candidates_array->len; i++)
+        {
+          RefreshRateCandidates *candidates =
+            &g_array_index (candidates_array, RefreshRateCandidates, i);
+          CcDisplayMode *mode =
+            g_ptr_array_index (candidates->modes, candidates->position);
+
+          if (mode->refresh_rate < min_rate)
+            {
+              min_rate = mode->refresh_rate;
+              lowest = candidates;
+            }
+          max_rate = MAX (max_rate, mode->refresh_rate);
+        }
+
+      if (max_rate - min_rate <= best_range)
+        {
+          best_range = max_rate - min_rate;
+          for (i = 0; i < candidates_array->len; i++)
+            {
+              RefreshRateCandidates *candidates =
+                &g_array_index (candidates_array, RefreshRateCandidates, i);
+
+              candidates->best_position = candidates->position;
+            }
+        }
+
+      if (lowest->position + 1 == lowest->modes->len)
+        break;
+
+      lowest->position++;
+    }
+
+  for (i = 0; i < candidates_array->len; i++)
+    {
+      RefreshRateCandidates *candidates =
+        &g_array_index (candidates_array, RefreshRateCandidates, i);
+
+      candidates->monitor_config->mode =
+        g_ptr_array_index (candidates->modes, candidates->best_position);
+    }
+
+  return best_range;
 }
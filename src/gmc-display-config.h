@@ -51,6 +51,15 @@ typedef enum
   CC_DISPLAY_TRANSFORM_FLIPPED_270,
 } CcDisplayTransform;
 
+typedef enum _CcDisplayPowerSaveMode
+{
+  CC_DISPLAY_POWER_SAVE_MODE_UNKNOWN = -1,
+  CC_DISPLAY_POWER_SAVE_MODE_ON = 0,
+  CC_DISPLAY_POWER_SAVE_MODE_STANDBY = 1,
+  CC_DISPLAY_POWER_SAVE_MODE_SUSPEND = 2,
+  CC_DISPLAY_POWER_SAVE_MODE_OFF = 3
+} CcDisplayPowerSaveMode;
+
 typedef struct _CcDisplayState CcDisplayState;
 typedef struct _CcDisplayMonitor CcDisplayMonitor;
 typedef struct _CcDisplayLogicalMonitor CcDisplayLogicalMonitor;
@@ -61,8 +70,35 @@ typedef struct _CcDisplayConfig CcDisplayConfig;
 
 typedef struct _CcDisplayMode CcDisplayMode;
 
+/* Criteria of cc_display_state_filter_modes(); zero fields match anything */
+typedef struct _CcDisplayModeFilter
+{
+  /* Only consider the modes of this monitor */
+  CcDisplayMonitor *monitor;
+  int min_width;
+  int min_height;
+  double min_refresh_rate;
+  /* A scale the mode has to support */
+  double scale;
+  gboolean exclude_interlaced;
+} CcDisplayModeFilter;
+
+/* Reply type of org.gnome.Mutter.DisplayConfig.GetCurrentState() */
+#define CC_DISPLAY_STATE_FORMAT \
+  "(ua((ssss)a(siiddada{sv})a{sv})a(iiduba(ssss)a{sv})a{sv})"
+
+CcDisplayState *cc_display_state_new_from_variant (GVariant *state_variant,
+                                                   GError **error);
+GVariant *cc_display_state_variant_new_from_file (const char *path,
+                                                  GError **error);
+gboolean cc_display_state_variant_save_to_file (GVariant *state_variant,
+                                                const char *path,
+                                                GError **error);
 CcDisplayState *cc_display_state_new_current (CcDbusDisplayConfig *proxy,
                                               GError **error);
+CcDisplayState * cc_display_state_ref (CcDisplayState *state);
+void cc_display_state_unref (CcDisplayState *state);
+/* Same as cc_display_state_unref() */
 void cc_display_state_free (CcDisplayState *state);
 
 unsigned int cc_display_state_get_serial (CcDisplayState *state);
@@ -71,22 +107,61 @@ GList *cc_display_state_get_logical_monitors (CcDisplayState *state);
 gboolean cc_display_state_get_max_screen_size (CcDisplayState *state,
                                                int *max_width,
                                                int *max_height);
+CcDisplayLayoutMode cc_display_state_get_layout_mode (CcDisplayState *state);
+gboolean cc_display_state_supports_changing_layout_mode (CcDisplayState *state);
+/* Modes of all monitors, addressed by row */
+unsigned int cc_display_state_get_n_modes (CcDisplayState *state);
+CcDisplayMode * cc_display_state_get_mode (CcDisplayState *state,
+                                           unsigned int row);
+CcDisplayMonitor * cc_display_state_get_mode_monitor (CcDisplayState *state,
+                                                      unsigned int row);
+unsigned int cc_display_state_filter_modes (CcDisplayState *state,
+                                            const CcDisplayModeFilter *filter,
+                                            unsigned int *rows);
+/* Logical monitors by position, in the layout mode of the state */
+unsigned int cc_display_state_get_n_logical_monitors (CcDisplayState *state);
+CcDisplayLogicalMonitor * cc_display_state_lookup_logical_monitor_at (CcDisplayState *state,
+                                                                      int x,
+                                                                      int y);
+unsigned int cc_display_state_find_logical_monitors_in_rect (CcDisplayState *state,
+                                                             const cairo_rectangle_int_t *rect,
+                                                             CcDisplayLogicalMonitor **logical_monitors);
+CcDisplayMonitor * cc_display_state_lookup_monitor (CcDisplayState *state,
+                                                    const char *selector,
+                                                    GError **error);
+guint cc_display_state_hash (gconstpointer state);
+gboolean cc_display_state_equal (gconstpointer state,
+                                 gconstpointer other_state);
 
 double *
 cc_display_mode_get_supported_scales (CcDisplayMode *mode,
 				      int *n_supported_scales);
 const char *
 cc_display_mode_get_id (CcDisplayMode *mode);
+bool cc_display_mode_is_interlaced (CcDisplayMode *mode);
+gboolean cc_display_mode_supports_scale (CcDisplayMode *mode,
+                                         double scale);
 
 GList * cc_display_logical_monitor_get_monitors (CcDisplayLogicalMonitor *logical_monitor);
 bool cc_display_logical_monitor_is_primary (CcDisplayLogicalMonitor *logical_monitor);
+void cc_display_logical_monitor_calculate_rect (CcDisplayLogicalMonitor *logical_monitor,
+                                                CcDisplayLayoutMode layout_mode,
+                                                cairo_rectangle_int_t *rect);
 void cc_display_logical_monitor_calculate_layout (CcDisplayLogicalMonitor *logical_monitor,
                                                   cairo_rectangle_int_t *layout);
 double cc_display_logical_monitor_get_scale (CcDisplayLogicalMonitor *logical_monitor);
 CcDisplayTransform cc_display_logical_monitor_get_transform (CcDisplayLogicalMonitor *logical_monitor);
 
 bool cc_display_monitor_is_active (CcDisplayMonitor *monitor);
+/*
+ * Identity strings are interned with g_intern_string(): the same connector,
+ * vendor, product, serial or mode id is the same pointer in every state.
+ */
 const char * cc_display_monitor_get_connector (CcDisplayMonitor *monitor);
+const char * cc_display_monitor_get_vendor (CcDisplayMonitor *monitor);
+const char * cc_display_monitor_get_product (CcDisplayMonitor *monitor);
+const char * cc_display_monitor_get_serial (CcDisplayMonitor *monitor);
+char * cc_display_monitor_dup_identity (CcDisplayMonitor *monitor);
 bool cc_display_monitor_is_builtin_display (CcDisplayMonitor *monitor);
 const char * cc_display_monitor_get_display_name (CcDisplayMonitor *monitor);
 
@@ -98,6 +173,12 @@ CcDisplayMode * cc_display_monitor_lookup_mode (CcDisplayMonitor *monitor,
 GList * cc_display_monitor_get_modes (CcDisplayMonitor *monitor);
 CcDisplayMode * cc_display_monitor_get_current_mode (CcDisplayMonitor *monitor);
 CcDisplayMode * cc_display_monitor_get_preferred_mode (CcDisplayMonitor *monitor);
+CcDisplayMode * cc_display_monitor_get_max_resolution_mode (CcDisplayMonitor *monitor);
+CcDisplayMode * cc_display_monitor_get_highest_refresh_mode (CcDisplayMonitor *monitor);
+CcDisplayMode * cc_display_monitor_get_native_mode (CcDisplayMonitor *monitor);
+CcDisplayMode * cc_display_monitor_get_best_mode_for_resolution (CcDisplayMonitor *monitor,
+                                                                 int width,
+                                                                 int height);
 
 void cc_display_mode_get_resolution (CcDisplayMode *mode,
 				     int *width,
@@ -111,6 +192,7 @@ void cc_display_monitor_config_set_mode (CcDisplayMonitorConfig *monitor_config,
                                          CcDisplayMode *mode);
 
 CcDisplayLogicalMonitorConfig * cc_display_logical_monitor_config_new (void);
+void cc_display_logical_monitor_config_free (CcDisplayLogicalMonitorConfig *logical_monitor_config);
 
 void cc_display_logical_monitor_config_set_position (CcDisplayLogicalMonitorConfig *logical_monitor_config,
                                                      int x,
@@ -141,16 +223,44 @@ void cc_display_logical_monitor_config_get_position (CcDisplayLogicalMonitorConf
 void cc_display_logical_monitor_config_calculate_layout (CcDisplayLogicalMonitorConfig *logical_monitor_config,
                                                          cairo_rectangle_int_t *layout);
 
+void cc_display_logical_monitor_config_calculate_rect (CcDisplayLogicalMonitorConfig *logical_monitor_config,
+                                                       CcDisplayLayoutMode layout_mode,
+                                                       cairo_rectangle_int_t *rect);
+
 GList * cc_display_logical_monitor_config_get_monitor_configs (CcDisplayLogicalMonitorConfig *logical_monitor_config);
 
+guint cc_display_logical_monitor_config_hash (gconstpointer logical_monitor_config);
+gboolean cc_display_logical_monitor_config_equal (gconstpointer logical_monitor_config,
+                                                  gconstpointer other_logical_monitor_config);
+
 CcDisplayConfig * cc_display_config_new (void);
+CcDisplayConfig * cc_display_config_new_from_state (CcDisplayState *state);
+void cc_display_config_free (CcDisplayConfig *config);
 
 void cc_display_config_set_layout_mode (CcDisplayConfig *config,
                                         CcDisplayLayoutMode layout_mode);
 gboolean cc_display_config_get_layout_mode (CcDisplayConfig *config,
                                             CcDisplayLayoutMode *layout_mode);
+/* Takes ownership of @logical_monitor_config */
 void cc_display_config_add_logical_monitor (CcDisplayConfig *config,
                                             CcDisplayLogicalMonitorConfig *logical_monitor_config);
 GList * cc_display_config_get_logical_logical_monitor_configs (CcDisplayConfig *config);
+CcDisplayMonitorConfig * cc_display_config_lookup_monitor_config (CcDisplayConfig *config,
+                                                                   CcDisplayMonitor *monitor,
+                                                                   CcDisplayLogicalMonitorConfig **out_logical_monitor_config);
+gboolean cc_display_config_remove_monitor (CcDisplayConfig *config,
+                                           CcDisplayMonitor *monitor);
+gboolean cc_display_config_is_current (CcDisplayConfig *config,
+                                       CcDisplayState *state);
+guint cc_display_config_hash (gconstpointer config);
+gboolean cc_display_config_equal (gconstpointer config,
+                                  gconstpointer other_config);
+char * cc_display_config_get_fingerprint (CcDisplayConfig *config,
+                                          CcDisplayState *state);
+double cc_display_config_sync_refresh_rates (CcDisplayConfig *config);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (CcDisplayState, cc_display_state_unref)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (CcDisplayLogicalMonitorConfig, cc_display_logical_monitor_config_free)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (CcDisplayConfig, cc_display_config_free)
 
 #endif /* _CC_DISPLAY_CONFIG_H */
@@ -0,0 +1,842 @@
+/*
+ * Copyright (C) 2026  The gnome-monitor-config authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "gmc-display-filter.h"
+
+#include <gio/gio.h>
+#include <math.h>
+#include <string.h>
+
+typedef enum _FieldId
+{
+  FIELD_CONNECTOR,
+  FIELD_VENDOR,
+  FIELD_PRODUCT,
+  FIELD_SERIAL,
+  FIELD_DISPLAY_NAME,
+  FIELD_IDENTITY,
+  FIELD_BUILTIN,
+  FIELD_ACTIVE,
+  FIELD_ID,
+  FIELD_WIDTH,
+  FIELD_HEIGHT,
+  FIELD_REFRESH,
+  FIELD_PREFERRED_SCALE,
+  FIELD_SCALES,
+  FIELD_CURRENT,
+  FIELD_PREFERRED,
+  FIELD_INTERLACED,
+} FieldId;
+
+typedef enum _FieldType
+{
+  FIELD_TYPE_STRING,
+  FIELD_TYPE_NUMBER,
+  FIELD_TYPE_BOOLEAN,
+  FIELD_TYPE_SCALES,
+} FieldType;
+
+typedef struct _Field
+{
+  const char *name;
+  FieldId id;
+  FieldType type;
+} Field;
+
+static const Field fields[] = {
+  { "connector", FIELD_CONNECTOR, FIELD_TYPE_STRING },
+  { "vendor", FIELD_VENDOR, FIELD_TYPE_STRING },
+  { "product", FIELD_PRODUCT, FIELD_TYPE_STRING },
+  { "serial", FIELD_SERIAL, FIELD_TYPE_STRING },
+  { "display-name", FIELD_DISPLAY_NAME, FIELD_TYPE_STRING },
+  { "identity", FIELD_IDENTITY, FIELD_TYPE_STRING },
+  { "builtin", FIELD_BUILTIN, FIELD_TYPE_BOOLEAN },
+  { "active", FIELD_ACTIVE, FIELD_TYPE_BOOLEAN },
+  { "id", FIELD_ID, FIELD_TYPE_STRING },
+  { "width", FIELD_WIDTH, FIELD_TYPE_NUMBER },
+  { "height", FIELD_HEIGHT, FIELD_TYPE_NUMBER },
+  { "refresh", FIELD_REFRESH, FIELD_TYPE_NUMBER },
+  { "preferred-scale", FIELD_PREFERRED_SCALE, FIELD_TYPE_NUMBER },
+  { "scales", FIELD_SCALES, FIELD_TYPE_SCALES },
+  { "current", FIELD_CURRENT, FIELD_TYPE_BOOLEAN },
+  { "preferred", FIELD_PREFERRED, FIELD_TYPE_BOOLEAN },
+  { "interlaced", FIELD_INTERLACED, FIELD_TYPE_BOOLEAN },
+};
+
+typedef enum _NodeType
+{
+  NODE_AND,
+  NODE_OR,
+  NODE_NOT,
+  NODE_COMPARE,
+} NodeType;
+
+typedef enum _CompareOp
+{
+  COMPARE_OP_EQUAL,
+  COMPARE_OP_NOT_EQUAL,
+  COMPARE_OP_LESS,
+  COMPARE_OP_LESS_OR_EQUAL,
+  COMPARE_OP_GREATER,
+  COMPARE_OP_GREATER_OR_EQUAL,
+} CompareOp;
+
+typedef struct _Node Node;
+
+struct _Node
+{
+  NodeType type;
+
+  /* NODE_AND, NODE_OR and NODE_NOT, which only uses left */
+  Node *left;
+  Node *right;
+
+  /* NODE_COMPARE */
+  const Field *field;
+  CompareOp op;
+  double number;
+  gboolean boolean;
+  GPatternSpec *pattern;
+};
+
+struct _CcDisplayFilter
+{
+  Node *root;
+  /* Conditions for cc_display_state_filter_modes(), see collect_mode_filter() */
+  CcDisplayModeFilter mode_filter;
+};
+
+struct _CcDisplayFieldList
+{
+  GPtrArray *fields;
+};
+
+static const Field *
+lookup_field (const char *name,
+              size_t length)
+{
+  unsigned int i;
+
+  for (i = 0; i < G_N_ELEMENTS (fields); i++)
+    {
+      if (strlen (fields[i].name) == length &&
+          strncmp (fields[i].name, name, length) == 0)
+        return &fields[i];
+    }
+
+  return NULL;
+}
+
+static void
+node_free (Node *node)
+{
+  if (!node)
+    return;
+
+  node_free (node->left);
+  node_free (node->right);
+  g_clear_pointer (&node->pattern, g_pattern_spec_free);
+  g_free (node);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (Node, node_free)
+
+typedef struct _Parser
+{
+  const char *expression;
+  const char *p;
+} Parser;
+
+static void
+skip_whitespace (Parser *parser)
+{
+  while (g_ascii_isspace (*parser->p))
+    parser->p++;
+}
+
+static gboolean
+accept (Parser *parser,
+        const char *token)
+{
+  skip_whitespace (parser);
+  if (!g_str_has_prefix (parser->p, token))
+    return FALSE;
+
+  parser->p += strlen (token);
+  return TRUE;
+}
+
+static void
+set_parse_error (Parser *parser,
+                 const char *expected,
+                 GError **error)
+{
+  if (*parser->p == '\0')
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                 "Invalid filter '%s': expected %s at the end",
+                 parser->expression, expected);
+  else
+    g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                 "Invalid filter '%s': expected %s at '%s'",
+                 parser->expression, expected, parser->p);
+}
+
+static gboolean
+is_word_char (char c)
+{
+  return c != '\0' && !g_ascii_isspace (c) && !strchr ("()&|!<>=\"'", c);
+}
+
+/* A bare word, or a string in single or double quotes */
+static char *
+parse_value (Parser *parser,
+             GError **error)
+{
+  const char *start;
+
+  skip_whitespace (parser);
+  if (*parser->p == '"' || *parser->p == '\'')
+    {
+      char quote = *parser->p;
+      const char *end;
+
+      start = parser->p + 1;
+      end = strchr (start, quote);
+      if (!end)
+        {
+          set_parse_error (parser, "a closing quote", error);
+          return NULL;
+        }
+
+      parser->p = end + 1;
+      return g_strndup (start, end - start);
+    }
+
+  start = parser->p;
+  while (is_word_char (*parser->p))
+    parser->p++;
+
+  if (parser->p == start)
+    {
+      set_parse_error (parser, "a value", error);
+      return NULL;
+    }
+
+  return g_strndup (start, parser->p - start);
+}
+
+static gboolean
+parse_boolean (const char *value,
+               gboolean *boolean)
+{
+  if (g_str_equal (value, "true") || g_str_equal (value, "yes") ||
+      g_str_equal (value, "1"))
+    *boolean = TRUE;
+  else if (g_str_equal (value, "false") || g_str_equal (value, "no") ||
+           g_str_equal (value, "0"))
+    *boolean = FALSE;
+  else
+    return FALSE;
+
+  return TRUE;
+}
+
+static Node *
+parse_comparison (Parser *parser,
+                  GError **error)
+{
+  g_autoptr(Node) node = NULL;
+  g_autofree char *value = NULL;
+  const char *start;
+  const Field *field;
+
+  skip_whitespace (parser);
+  start = parser->p;
+  while (g_ascii_isalnum (*parser->p) || *parser->p == '-')
+    parser->p++;
+
+  field = lookup_field (start, parser->p - start);
+  if (!field)
+    {
+      parser->p = start;
+      set_parse_error (parser, "a field name", error);
+      return NULL;
+    }
+
+  node = g_new0 (Node, 1);
+  node->type = NODE_COMPARE;
+  node->field = field;
+
+  /* Checked longest first, so that "<=" isn't taken for "<" */
+  if (accept (parser, "!="))
+    node->op = COMPARE_OP_NOT_EQUAL;
+  else if (accept (parser, "<="))
+    node->op = COMPARE_OP_LESS_OR_EQUAL;
+  else if (accept (parser, ">="))
+    node->op = COMPARE_OP_GREATER_OR_EQUAL;
+  else if (accept (parser, "==") || accept (parser, "="))
+    node->op = COMPARE_OP_EQUAL;
+  else if (accept (parser, "<"))
+    node->op = COMPARE_OP_LESS;
+  else if (accept (parser, ">"))
+    node->op = COMPARE_OP_GREATER;
+  else if (field->type == FIELD_TYPE_BOOLEAN)
+    {
+      node->op = COMPARE_OP_EQUAL;
+      node->boolean = TRUE;
+      return g_steal_pointer (&node);
+    }
+  else
+    {
+      set_parse_error (parser, "a comparison", error);
+      return NULL;
+    }
+
+  if (field->type != FIELD_TYPE_NUMBER &&
+      node->op != COMPARE_OP_EQUAL && node->op != COMPARE_OP_NOT_EQUAL)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                   "Invalid filter '%s': %s can only be compared with = and !=",
+                   parser->expression, field->name);
+      return NULL;
+    }
+
+  value = parse_value (parser, error);
+  if (!value)
+    return NULL;
+
+  switch (field->type)
+    {
+    case FIELD_TYPE_STRING:
+      node->pattern = g_pattern_spec_new (value);
+      break;
+
+    case FIELD_TYPE_NUMBER:
+    case FIELD_TYPE_SCALES:
+      {
+        char *end;
+
+        node->number = g_ascii_strtod (value, &end);
+        if (*end != '\0' || !isfinite (node->number))
+          {
+            g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                         "Invalid filter '%s': %s is not a number",
+                         parser->expression, value);
+            return NULL;
+          }
+        break;
+      }
+
+    case FIELD_TYPE_BOOLEAN:
+      if (!parse_boolean (value, &node->boolean))
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                       "Invalid filter '%s': %s is not true or false",
+                       parser->expression, value);
+          return NULL;
+        }
+      break;
+    }
+
+  return g_steal_pointer (&node);
+}
+
+static Node * parse_or (Parser *parser,
+                        GError **error);
+
+static Node *
+parse_unary (Parser *parser,
+             GError **error)
+{
+  if (accept (parser, "!"))
+    {
+      g_autoptr(Node) node = NULL;
+
+      node = g_new0 (Node, 1);
+      node->type = NODE_NOT;
+      node->left = parse_unary (parser, error);
+      if (!node->left)
+        return NULL;
+
+      return g_steal_pointer (&node);
+    }
+
+  if (accept (parser, "("))
+    {
+      g_autoptr(Node) node = NULL;
+
+      node = parse_or (parser, error);
+      if (!node)
+        return NULL;
+
+      if (!accept (parser, ")"))
+        {
+          set_parse_error (parser, "')'", error);
+          return NULL;
+        }
+
+      return g_steal_pointer (&node);
+    }
+
+  return parse_comparison (parser, error);
+}
+
+static Node *
+parse_binary (Parser *parser,
+              NodeType type,
+              GError **error)
+{
+  g_autoptr(Node) node = NULL;
+  const char *token;
+
+  if (type == NODE_OR)
+    {
+      token = "||";
+      node = parse_binary (parser, NODE_AND, error);
+    }
+  else
+    {
+      token = "&&";
+      node = parse_unary (parser, error);
+    }
+
+  if (!node)
+    return NULL;
+
+  while (accept (parser, token))
+    {
+      g_autoptr(Node) right = NULL;
+      Node *parent;
+
+      if (type == NODE_OR)
+        right = parse_binary (parser, NODE_AND, error);
+      else
+        right = parse_unary (parser, error);
+      if (!right)
+        return NULL;
+
+      parent = g_new0 (Node, 1);
+      parent->type = type;
+      parent->left = g_steal_pointer (&node);
+      parent->right = g_steal_pointer (&right);
+      node = parent;
+    }
+
+  return g_steal_pointer (&node);
+}
+
+static Node *
+parse_or (Parser *parser,
+          GError **error)
+{
+  return parse_binary (parser, NODE_OR, error);
+}
+
+static int
+to_min_dimension (double value)
+{
+  return (int) CLAMP (value, 0, G_MAXINT);
+}
+
+/*
+ * Collects the conditions every row matching @node meets, as far as
+ * cc_display_state_filter_modes() can express them, into @mode_filter. Only
+ * conjunctions are followed, and comparisons it has no equivalent for are
+ * relaxed to ones it has, so it finds a superset of the matching rows.
+ */
+static void
+collect_mode_filter (Node *node,
+                     CcDisplayModeFilter *mode_filter)
+{
+  switch (node->type)
+    {
+    case NODE_AND:
+      collect_mode_filter (node->left, mode_filter);
+      collect_mode_filter (node->right, mode_filter);
+      return;
+    case NODE_OR:
+      return;
+    case NODE_NOT:
+      /* "!interlaced" */
+      if (node->left->type == NODE_COMPARE &&
+          node->left->field->id == FIELD_INTERLACED &&
+          node->left->op == COMPARE_OP_EQUAL && node->left->boolean)
+        mode_filter->exclude_interlaced = TRUE;
+      return;
+    case NODE_COMPARE:
+      break;
+    }
+
+  switch (node->field->id)
+    {
+    case FIELD_WIDTH:
+    case FIELD_HEIGHT:
+      {
+        int *min_dimension;
+
+        min_dimension = node->field->id == FIELD_WIDTH ? &mode_filter->min_width
+                                                       : &mode_filter->min_height;
+        if (node->op == COMPARE_OP_GREATER_OR_EQUAL ||
+            node->op == COMPARE_OP_EQUAL)
+          *min_dimension = MAX (*min_dimension,
+                                to_min_dimension (ceil (node->number)));
+        else if (node->op == COMPARE_OP_GREATER)
+          *min_dimension = MAX (*min_dimension,
+                                to_min_dimension (floor (node->number) + 1));
+        break;
+      }
+
+    case FIELD_REFRESH:
+      if (node->op == COMPARE_OP_GREATER_OR_EQUAL ||
+          node->op == COMPARE_OP_GREATER ||
+          node->op == COMPARE_OP_EQUAL)
+        mode_filter->min_refresh_rate = MAX (mode_filter->min_refresh_rate,
+                                             node->number);
+      break;
+
+    case FIELD_SCALES:
+      if (node->op == COMPARE_OP_EQUAL && mode_filter->scale == 0)
+        mode_filter->scale = node->number;
+      break;
+
+    case FIELD_INTERLACED:
+      if (node->op == COMPARE_OP_EQUAL && !node->boolean)
+        mode_filter->exclude_interlaced = TRUE;
+      break;
+
+    default:
+      break;
+    }
+}
+
+/*
+ * Compiles @expression into a tree of comparisons with their values, glob
+ * patterns included, already parsed, so matching doesn't parse anything.
+ */
+CcDisplayFilter *
+cc_display_filter_new (const char *expression,
+                       GError **error)
+{
+  Parser parser = { .expression = expression, .p = expression };
+  g_autoptr(Node) root = NULL;
+  CcDisplayFilter *filter;
+
+  root = parse_or (&parser, error);
+  if (!root)
+    return NULL;
+
+  skip_whitespace (&parser);
+  if (*parser.p != '\0')
+    {
+      set_parse_error (&parser, "'&&' or '||'", error);
+      return NULL;
+    }
+
+  filter = g_new0 (CcDisplayFilter, 1);
+  filter->root = g_steal_pointer (&root);
+  collect_mode_filter (filter->root, &filter->mode_filter);
+
+  return filter;
+}
+
+void
+cc_display_filter_free (CcDisplayFilter *filter)
+{
+  node_free (filter->root);
+  g_free (filter);
+}
+
+static const char *
+get_string_field (const Field *field,
+                  CcDisplayMonitor *monitor,
+                  CcDisplayMode *mode,
+                  char **allocated)
+{
+  switch (field->id)
+    {
+    case FIELD_CONNECTOR:
+      return cc_display_monitor_get_connector (monitor);
+    case FIELD_VENDOR:
+      return cc_display_monitor_get_vendor (monitor);
+    case FIELD_PRODUCT:
+      return cc_display_monitor_get_product (monitor);
+    case FIELD_SERIAL:
+      return cc_display_monitor_get_serial (monitor);
+    case FIELD_DISPLAY_NAME:
+      return cc_display_monitor_get_display_name (monitor);
+    case FIELD_IDENTITY:
+      *allocated = cc_display_monitor_dup_identity (monitor);
+      return *allocated;
+    case FIELD_ID:
+      return cc_display_mode_get_id (mode);
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+static double
+get_number_field (const Field *field,
+                  CcDisplayMode *mode)
+{
+  int width, height;
+
+  switch (field->id)
+    {
+    case FIELD_WIDTH:
+      cc_display_mode_get_resolution (mode, &width, &height);
+      return width;
+    case FIELD_HEIGHT:
+      cc_display_mode_get_resolution (mode, &width, &height);
+      return height;
+    case FIELD_REFRESH:
+      return cc_display_mode_get_refresh_rate (mode);
+    case FIELD_PREFERRED_SCALE:
+      return cc_display_mode_get_preferred_scale (mode);
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+static gboolean
+get_boolean_field (const Field *field,
+                   CcDisplayMonitor *monitor,
+                   CcDisplayMode *mode)
+{
+  switch (field->id)
+    {
+    case FIELD_BUILTIN:
+      return cc_display_monitor_is_builtin_display (monitor);
+    case FIELD_ACTIVE:
+      return cc_display_monitor_is_active (monitor);
+    case FIELD_CURRENT:
+      return mode == cc_display_monitor_get_current_mode (monitor);
+    case FIELD_PREFERRED:
+      return mode == cc_display_monitor_get_preferred_mode (monitor);
+    case FIELD_INTERLACED:
+      return cc_display_mode_is_interlaced (mode);
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+static gboolean
+compare_numbers (CompareOp op,
+                 double value,
+                 double reference)
+{
+  switch (op)
+    {
+    case COMPARE_OP_EQUAL:
+      return value == reference;
+    case COMPARE_OP_NOT_EQUAL:
+      return value != reference;
+    case COMPARE_OP_LESS:
+      return value < reference;
+    case COMPARE_OP_LESS_OR_EQUAL:
+      return value <= reference;
+    case COMPARE_OP_GREATER:
+      return value > reference;
+    case COMPARE_OP_GREATER_OR_EQUAL:
+      return value >= reference;
+    }
+
+  g_assert_not_reached ();
+}
+
+static gboolean
+node_matches (Node *node,
+              CcDisplayMonitor *monitor,
+              CcDisplayMode *mode)
+{
+  gboolean is_equal;
+
+  switch (node->type)
+    {
+    case NODE_AND:
+      return (node_matches (node->left, monitor, mode) &&
+              node_matches (node->right, monitor, mode));
+    case NODE_OR:
+      return (node_matches (node->left, monitor, mode) ||
+              node_matches (node->right, monitor, mode));
+    case NODE_NOT:
+      return !node_matches (node->left, monitor, mode);
+    case NODE_COMPARE:
+      break;
+    }
+
+  switch (node->field->type)
+    {
+    case FIELD_TYPE_STRING:
+      {
+        g_autofree char *allocated = NULL;
+        const char *value;
+
+        value = get_string_field (node->field, monitor, mode, &allocated);
+        is_equal = value && g_pattern_spec_match_string (node->pattern, value);
+        break;
+      }
+
+    case FIELD_TYPE_NUMBER:
+      return compare_numbers (node->op,
+                              get_number_field (node->field, mode),
+                              node->number);
+
+    case FIELD_TYPE_BOOLEAN:
+      is_equal = get_boolean_field (node->field, monitor, mode) == node->boolean;
+      break;
+
+    case FIELD_TYPE_SCALES:
+      is_equal = cc_display_mode_supports_scale (mode, node->number);
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+
+  return node->op == COMPARE_OP_EQUAL ? is_equal : !is_equal;
+}
+
+gboolean
+cc_display_filter_matches (CcDisplayFilter *filter,
+                           CcDisplayMonitor *monitor,
+                           CcDisplayMode *mode)
+{
+  return node_matches (filter->root, monitor, mode);
+}
+
+/*
+ * The numeric conditions narrow the rows down in one batch pass over the mode
+ * table, and only the remaining candidates get the whole expression
+ * evaluated.
+ */
+unsigned int
+cc_display_filter_find_modes (CcDisplayFilter *filter,
+                              CcDisplayState *state,
+                              unsigned int *rows)
+{
+  unsigned int n_candidates;
+  unsigned int n_matches = 0;
+  unsigned int i;
+
+  n_candidates = cc_display_state_filter_modes (state, &filter->mode_filter,
+                                                rows);
+  for (i = 0; i < n_candidates; i++)
+    {
+      if (cc_display_filter_matches (filter,
+                                     cc_display_state_get_mode_monitor (state,
+                                                                        rows[i]),
+                                     cc_display_state_get_mode (state, rows[i])))
+        rows[n_matches++] = rows[i];
+    }
+
+  return n_matches;
+}
+
+CcDisplayFieldList *
+cc_display_field_list_new (const char *field_names,
+                           GError **error)
+{
+  g_autoptr(GPtrArray) field_list = NULL;
+  g_auto(GStrv) names = NULL;
+  CcDisplayFieldList *list;
+  unsigned int i;
+
+  field_list = g_ptr_array_new ();
+  names = g_strsplit (field_names, ",", -1);
+  for (i = 0; names[i]; i++)
+    {
+      const char *name = g_strstrip (names[i]);
+      const Field *field;
+
+      field = lookup_field (name, strlen (name));
+      if (!field)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                       "Unknown field '%s'", name);
+          return NULL;
+        }
+
+      g_ptr_array_add (field_list, (gpointer) field);
+    }
+
+  list = g_new0 (CcDisplayFieldList, 1);
+  list->fields = g_steal_pointer (&field_list);
+
+  return list;
+}
+
+void
+cc_display_field_list_free (CcDisplayFieldList *field_list)
+{
+  g_ptr_array_unref (field_list->fields);
+  g_free (field_list);
+}
+
+void
+cc_display_field_list_append_row (CcDisplayFieldList *field_list,
+                                  CcDisplayMonitor *monitor,
+                                  CcDisplayMode *mode,
+                                  GString *row)
+{
+  unsigned int i;
+
+  for (i = 0; i < field_list->fields->len; i++)
+    {
+      const Field *field = g_ptr_array_index (field_list->fields, i);
+
+      if (i > 0)
+        g_string_append_c (row, '\t');
+
+      switch (field->type)
+        {
+        case FIELD_TYPE_STRING:
+          {
+            g_autofree char *allocated = NULL;
+            const char *value;
+
+            value = get_string_field (field, monitor, mode, &allocated);
+            g_string_append (row, value ? value : "");
+            break;
+          }
+
+        case FIELD_TYPE_NUMBER:
+          g_string_append_printf (row, "%g", get_number_field (field, mode));
+          break;
+
+        case FIELD_TYPE_BOOLEAN:
+          g_string_append (row, get_boolean_field (field, monitor, mode) ? "yes"
+                                                                         : "no");
+          break;
+
+        case FIELD_TYPE_SCALES:
+          {
+            g_autofree double *supported_scales = NULL;
+            int n_supported_scales;
+            int j;
+
+            supported_scales =
+              cc_display_mode_get_supported_scales (mode, &n_supported_scales);
+            for (j = 0; j < n_supported_scales; j++)
+              g_string_append_printf (row, "%s%g",
+                                      j > 0 ? " " : "", supported_scales[j]);
+            break;
+          }
+        }
+    }
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2026  The gnome-monitor-config authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _CC_DISPLAY_FILTER_H
+#define _CC_DISPLAY_FILTER_H
+
+#include <glib.h>
+
+#include "gmc-display-config.h"
+
+/*
+ * Filters and field lists work on rows of a monitor and one of its modes.
+ *
+ * Fields are connector, vendor, product, serial, display-name, identity,
+ * builtin, active, id, width, height, refresh, preferred-scale, scales,
+ * current, preferred and interlaced.
+ *
+ * A filter expression compares fields with =, !=, <, <=, > and >=, and
+ * combines comparisons with &&, || and ! and parentheses, e.g.
+ * "connector=DP-* && width>=3840 && refresh>=120". Strings are compared
+ * as glob patterns, "scales=1.5" matches modes supporting scale 1.5 and
+ * boolean fields may be used on their own, as in "current || preferred".
+ */
+typedef struct _CcDisplayFilter CcDisplayFilter;
+typedef struct _CcDisplayFieldList CcDisplayFieldList;
+
+CcDisplayFilter * cc_display_filter_new (const char *expression,
+                                         GError **error);
+void cc_display_filter_free (CcDisplayFilter *filter);
+
+gboolean cc_display_filter_matches (CcDisplayFilter *filter,
+                                    CcDisplayMonitor *monitor,
+                                    CcDisplayMode *mode);
+
+/*
+ * Stores the mode table rows matching @filter in @rows, which must have room
+ * for cc_display_state_get_n_modes() entries, and returns their number.
+ */
+unsigned int cc_display_filter_find_modes (CcDisplayFilter *filter,
+                                           CcDisplayState *state,
+                                           unsigned int *rows);
+
+/* @fields is a comma separated list of field names */
+CcDisplayFieldList * cc_display_field_list_new (const char *fields,
+                                                GError **error);
+void cc_display_field_list_free (CcDisplayFieldList *field_list);
+
+/* Appends the values of the fields, separated by tabs */
+void cc_display_field_list_append_row (CcDisplayFieldList *field_list,
+                                       CcDisplayMonitor *monitor,
+                                       CcDisplayMode *mode,
+                                       GString *row);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (CcDisplayFilter, cc_display_filter_free)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (CcDisplayFieldList, cc_display_field_list_free)
+
+#endif /* _CC_DISPLAY_FILTER_H */
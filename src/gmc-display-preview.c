@@ -0,0 +1,483 @@
+/*
+ * Copyright (C) 2026  The gnome-monitor-config authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "gmc-display-preview.h"
+
+#include <gio/gio.h>
+#include <math.h>
+#include <string.h>
+
+#include "gmc-rect.h"
+
+#define PREVIEW_PNG_WIDTH 1024
+#define PREVIEW_PNG_MARGIN 24
+#define PREVIEW_PNG_LINE_HEIGHT 18
+
+typedef struct _PreviewItem
+{
+  cairo_rectangle_int_t rect;
+  char *connectors;
+  char *description;
+  bool is_primary;
+  bool is_isolated;
+} PreviewItem;
+
+typedef struct _Preview
+{
+  GArray *items;
+  GArray *overlaps;
+  cairo_rectangle_int_t bounds;
+} Preview;
+
+static const char *
+transform_to_string (CcDisplayTransform transform)
+{
+  switch (transform)
+    {
+    case CC_DISPLAY_TRANSFORM_NORMAL:
+      return "normal";
+    case CC_DISPLAY_TRANSFORM_90:
+      return "left";
+    case CC_DISPLAY_TRANSFORM_180:
+      return "upside-down";
+    case CC_DISPLAY_TRANSFORM_270:
+      return "right";
+    case CC_DISPLAY_TRANSFORM_FLIPPED:
+      return "flipped";
+    case CC_DISPLAY_TRANSFORM_FLIPPED_90:
+      return "flipped-left";
+    case CC_DISPLAY_TRANSFORM_FLIPPED_180:
+      return "flipped-upside-down";
+    case CC_DISPLAY_TRANSFORM_FLIPPED_270:
+      return "flipped-right";
+    }
+
+  return "unknown";
+}
+
+static void
+clear_preview_item (PreviewItem *item)
+{
+  g_free (item->connectors);
+  g_free (item->description);
+}
+
+static void
+create_preview_item (CcDisplayLogicalMonitorConfig *logical_monitor_config,
+                     CcDisplayLayoutMode layout_mode,
+                     PreviewItem *item)
+{
+  g_autoptr(GString) connectors = NULL;
+  CcDisplayMode *mode = NULL;
+  int width = 0, height = 0;
+  GList *l;
+
+  connectors = g_string_new (NULL);
+  for (l = cc_display_logical_monitor_config_get_monitor_configs (logical_monitor_config);
+       l;
+       l = l->next)
+    {
+      CcDisplayMonitorConfig *monitor_config = l->data;
+      CcDisplayMonitor *monitor;
+
+      monitor = cc_display_monitor_config_get_monitor (monitor_config);
+      if (connectors->len > 0)
+        g_string_append_c (connectors, '+');
+      g_string_append (connectors, cc_display_monitor_get_connector (monitor));
+
+      if (!mode)
+        mode = cc_display_monitor_config_get_mode (monitor_config);
+    }
+
+  if (mode)
+    cc_display_mode_get_resolution (mode, &width, &height);
+
+  *item = (PreviewItem) {
+    .connectors = g_strdup (connectors->str),
+    .is_primary =
+      cc_display_logical_monitor_config_is_primary (logical_monitor_config),
+  };
+  cc_display_logical_monitor_config_calculate_rect (logical_monitor_config,
+                                                    layout_mode,
+                                                    &item->rect);
+  item->description =
+    g_strdup_printf ("%dx%d@%g at %dx%d+%d+%d, scale %g, %s%s",
+                     width, height,
+                     mode ? cc_display_mode_get_refresh_rate (mode) : 0.0,
+                     item->rect.width, item->rect.height,
+                     item->rect.x, item->rect.y,
+                     cc_display_logical_monitor_config_get_scale (logical_monitor_config),
+                     transform_to_string (cc_display_logical_monitor_config_get_transform (logical_monitor_config)),
+                     item->is_primary ? ", PRIMARY" : "");
+}
+
+static void
+init_preview (Preview *preview,
+              CcDisplayConfig *config,
+              CcDisplayLayoutMode layout_mode)
+{
+  unsigned int i, j;
+  GList *l;
+
+  *preview = (Preview) {
+    .items = g_array_new (FALSE, FALSE, sizeof (PreviewItem)),
+    .overlaps = g_array_new (FALSE, FALSE, sizeof (cairo_rectangle_int_t)),
+  };
+  g_array_set_clear_func (preview->items, (GDestroyNotify) clear_preview_item);
+
+  for (l = cc_display_config_get_logical_logical_monitor_configs (config);
+       l;
+       l = l->next)
+    {
+      PreviewItem item;
+
+      create_preview_item (l->data, layout_mode, &item);
+      if (preview->items->len == 0)
+        preview->bounds = item.rect;
+      else
+        gmc_rect_union (&preview->bounds, &item.rect, &preview->bounds);
+      g_array_append_val (preview->items, item);
+    }
+
+  for (i = 0; i < preview->items->len; i++)
+    {
+      PreviewItem *item = &g_array_index (preview->items, PreviewItem, i);
+      bool is_touching = preview->items->len == 1;
+
+      for (j = 0; j < preview->items->len; j++)
+        {
+          PreviewItem *other = &g_array_index (preview->items, PreviewItem, j);
+          cairo_rectangle_int_t overlap;
+
+          if (i == j)
+            continue;
+
+          if (gmc_rect_intersect (&item->rect, &other->rect, &overlap))
+            {
+              is_touching = true;
+              if (i < j)
+                g_array_append_val (preview->overlaps, overlap);
+            }
+          else if (gmc_rect_is_adjacent (&item->rect, &other->rect))
+            {
+              is_touching = true;
+            }
+        }
+
+      item->is_isolated = !is_touching;
+    }
+}
+
+static void
+clear_preview (Preview *preview)
+{
+  g_array_unref (preview->items);
+  g_array_unref (preview->overlaps);
+}
+
+/* The legend followed by the problems the compositor would reject */
+static GPtrArray *
+get_preview_text_lines (Preview *preview)
+{
+  GPtrArray *lines;
+  unsigned int i;
+
+  lines = g_ptr_array_new_with_free_func (g_free);
+
+  for (i = 0; i < preview->items->len; i++)
+    {
+      PreviewItem *item = &g_array_index (preview->items, PreviewItem, i);
+
+      g_ptr_array_add (lines, g_strdup_printf ("[%u] %s: %s",
+                                               i + 1, item->connectors,
+                                               item->description));
+    }
+
+  for (i = 0; i < preview->overlaps->len; i++)
+    {
+      cairo_rectangle_int_t *overlap =
+        &g_array_index (preview->overlaps, cairo_rectangle_int_t, i);
+
+      g_ptr_array_add (lines,
+                       g_strdup_printf ("Overlap at %dx%d+%d+%d",
+                                        overlap->width, overlap->height,
+                                        overlap->x, overlap->y));
+    }
+
+  for (i = 0; i < preview->items->len; i++)
+    {
+      PreviewItem *item = &g_array_index (preview->items, PreviewItem, i);
+
+      if (item->is_isolated)
+        g_ptr_array_add (lines,
+                         g_strdup_printf ("Gap: [%u] %s touches no other monitor",
+                                          i + 1, item->connectors));
+    }
+
+  return lines;
+}
+
+gboolean
+cc_display_preview_render_png (CcDisplayConfig *config,
+                               CcDisplayLayoutMode layout_mode,
+                               const char *path,
+                               GError **error)
+{
+  Preview preview;
+  g_autoptr(GPtrArray) lines = NULL;
+  cairo_surface_t *surface;
+  cairo_t *cr;
+  cairo_status_t status;
+  double scale;
+  int layout_height;
+  unsigned int i;
+
+  init_preview (&preview, config, layout_mode);
+  if (preview.items->len == 0 || preview.bounds.width <= 0)
+    {
+      clear_preview (&preview);
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                   "No logical monitors to render");
+      return FALSE;
+    }
+
+  lines = get_preview_text_lines (&preview);
+
+  scale = (PREVIEW_PNG_WIDTH - 2 * PREVIEW_PNG_MARGIN) /
+          (double) preview.bounds.width;
+  layout_height = (int) ceil (preview.bounds.height * scale);
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24,
+                                        PREVIEW_PNG_WIDTH,
+                                        layout_height +
+                                        3 * PREVIEW_PNG_MARGIN +
+                                        lines->len * PREVIEW_PNG_LINE_HEIGHT);
+  cr = cairo_create (surface);
+
+  cairo_set_source_rgb (cr, 1.0, 1.0, 1.0);
+  cairo_paint (cr);
+
+  cairo_select_font_face (cr, "sans-serif",
+                          CAIRO_FONT_SLANT_NORMAL, CAIRO_FONT_WEIGHT_NORMAL);
+  cairo_set_font_size (cr, 13.0);
+  cairo_set_line_width (cr, 2.0);
+  cairo_translate (cr, PREVIEW_PNG_MARGIN, PREVIEW_PNG_MARGIN);
+
+  for (i = 0; i < preview.items->len; i++)
+    {
+      PreviewItem *item = &g_array_index (preview.items, PreviewItem, i);
+      g_autofree char *label = NULL;
+      double x, y, width, height;
+
+      x = (item->rect.x - preview.bounds.x) * scale;
+      y = (item->rect.y - preview.bounds.y) * scale;
+      width = item->rect.width * scale;
+      height = item->rect.height * scale;
+
+      cairo_rectangle (cr, x + 1, y + 1, width - 2, height - 2);
+      if (item->is_primary)
+        cairo_set_source_rgb (cr, 0.55, 0.75, 0.95);
+      else
+        cairo_set_source_rgb (cr, 0.80, 0.87, 0.95);
+      cairo_fill_preserve (cr);
+
+      if (item->is_isolated)
+        {
+          const double dashes[] = { 6.0, 4.0 };
+
+          cairo_set_source_rgb (cr, 0.85, 0.1, 0.1);
+          cairo_set_dash (cr, dashes, G_N_ELEMENTS (dashes), 0);
+        }
+      else
+        {
+          cairo_set_source_rgb (cr, 0.15, 0.25, 0.4);
+        }
+      cairo_stroke (cr);
+      cairo_set_dash (cr, NULL, 0, 0);
+
+      label = g_strdup_printf ("[%u] %s%s", i + 1, item->connectors,
+                               item->is_primary ? " (primary)" : "");
+      cairo_set_source_rgb (cr, 0.0, 0.0, 0.0);
+      cairo_move_to (cr, x + 8, y + 8 + PREVIEW_PNG_LINE_HEIGHT);
+      cairo_show_text (cr, label);
+    }
+
+  for (i = 0; i < preview.overlaps->len; i++)
+    {
+      cairo_rectangle_int_t *overlap =
+        &g_array_index (preview.overlaps, cairo_rectangle_int_t, i);
+
+      cairo_rectangle (cr,
+                       (overlap->x - preview.bounds.x) * scale,
+                       (overlap->y - preview.bounds.y) * scale,
+                       overlap->width * scale,
+                       overlap->height * scale);
+      cairo_set_source_rgba (cr, 0.9, 0.1, 0.1, 0.5);
+      cairo_fill (cr);
+    }
+
+  cairo_set_source_rgb (cr, 0.0, 0.0, 0.0);
+  for (i = 0; i < lines->len; i++)
+    {
+      cairo_move_to (cr, 0,
+                     layout_height + PREVIEW_PNG_MARGIN +
+                     (i + 1) * PREVIEW_PNG_LINE_HEIGHT);
+      cairo_show_text (cr, g_ptr_array_index (lines, i));
+    }
+
+  cairo_destroy (cr);
+  status = cairo_surface_write_to_png (surface, path);
+  cairo_surface_destroy (surface);
+  clear_preview (&preview);
+
+  if (status != CAIRO_STATUS_SUCCESS)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Failed to write %s: %s", path,
+                   cairo_status_to_string (status));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/*
+ * Both edges are rounded the same way, so that a monitor ends right before
+ * the cell its right or bottom neighbour starts in, and touching monitors
+ * never share a cell.
+ */
+static void
+get_cell_range (int start,
+                int length,
+                int bounds_start,
+                int bounds_length,
+                int n_cells,
+                int *first_cell,
+                int *last_cell)
+{
+  *first_cell = (int) round ((start - bounds_start) * (double) n_cells /
+                             bounds_length);
+  *last_cell = (int) round ((start + length - bounds_start) * (double) n_cells /
+                            bounds_length) - 1;
+
+  *first_cell = CLAMP (*first_cell, 0, n_cells - 1);
+  *last_cell = CLAMP (*last_cell, *first_cell, n_cells - 1);
+}
+
+/*
+ * Every logical monitor is drawn as a box; cells covered by more than one
+ * of them are filled with '#'. Text cells are about twice as high as wide,
+ * hence the halved number of rows.
+ */
+char *
+cc_display_preview_render_ascii (CcDisplayConfig *config,
+                                 CcDisplayLayoutMode layout_mode,
+                                 int columns)
+{
+  Preview preview;
+  g_autoptr(GPtrArray) lines = NULL;
+  g_autofree char *grid = NULL;
+  g_autofree unsigned int *coverage = NULL;
+  GString *output;
+  int rows;
+  int row, column;
+  unsigned int i;
+
+  init_preview (&preview, config, layout_mode);
+  if (preview.items->len == 0 || preview.bounds.width <= 0)
+    {
+      clear_preview (&preview);
+      return g_strdup ("(no logical monitors)\n");
+    }
+
+  columns = MAX (columns, 8);
+  rows = (int) round (columns * (double) preview.bounds.height /
+                      preview.bounds.width / 2.0);
+  rows = MAX (rows, 3);
+
+  grid = g_malloc (rows * columns);
+  memset (grid, ' ', rows * columns);
+  coverage = g_new0 (unsigned int, rows * columns);
+
+  for (i = 0; i < preview.items->len; i++)
+    {
+      PreviewItem *item = &g_array_index (preview.items, PreviewItem, i);
+      g_autofree char *label = NULL;
+      int x1, x2, y1, y2;
+
+      get_cell_range (item->rect.x, item->rect.width,
+                      preview.bounds.x, preview.bounds.width, columns,
+                      &x1, &x2);
+      get_cell_range (item->rect.y, item->rect.height,
+                      preview.bounds.y, preview.bounds.height, rows,
+                      &y1, &y2);
+
+      for (row = y1; row <= y2; row++)
+        {
+          for (column = x1; column <= x2; column++)
+            {
+              char c;
+
+              if ((row == y1 || row == y2) && (column == x1 || column == x2))
+                c = '+';
+              else if (row == y1 || row == y2)
+                c = '-';
+              else if (column == x1 || column == x2)
+                c = '|';
+              else
+                c = ' ';
+
+              grid[row * columns + column] = c;
+              coverage[row * columns + column]++;
+            }
+        }
+
+      label = g_strdup_printf ("[%u]%s", i + 1, item->is_primary ? "*" : "");
+      if (y2 - y1 >= 2 && x2 - x1 - 1 >= (int) strlen (label))
+        memcpy (&grid[(y1 + 1) * columns + x1 + 1], label, strlen (label));
+    }
+
+  for (i = 0; i < (unsigned int) (rows * columns); i++)
+    {
+      if (coverage[i] > 1)
+        grid[i] = '#';
+    }
+
+  output = g_string_new (NULL);
+  for (row = 0; row < rows; row++)
+    {
+      int length = columns;
+
+      while (length > 0 && grid[row * columns + length - 1] == ' ')
+        length--;
+
+      g_string_append_len (output, &grid[row * columns], length);
+      g_string_append_c (output, '\n');
+    }
+
+  lines = get_preview_text_lines (&preview);
+  g_string_append_c (output, '\n');
+  for (i = 0; i < lines->len; i++)
+    g_string_append_printf (output, "%s\n",
+                            (char *) g_ptr_array_index (lines, i));
+
+  clear_preview (&preview);
+
+  return g_string_free (output, FALSE);
+}
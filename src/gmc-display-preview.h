@@ -0,0 +1,44 @@
+/*
+ * Copyright (C) 2026  The gnome-monitor-config authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _CC_DISPLAY_PREVIEW_H
+#define _CC_DISPLAY_PREVIEW_H
+
+#include <glib.h>
+
+#include "gmc-display-config.h"
+
+/*
+ * Renders the layout of @config without involving the compositor. Logical
+ * monitors are drawn at their transformed, and in the logical layout mode
+ * scaled, size, labelled with their connectors. Overlapping areas and
+ * logical monitors not touching any other one are highlighted, as the
+ * compositor would reject them.
+ */
+gboolean cc_display_preview_render_png (CcDisplayConfig *config,
+                                        CcDisplayLayoutMode layout_mode,
+                                        const char *path,
+                                        GError **error);
+
+/* Returns a text diagram @columns characters wide, followed by a legend */
+char * cc_display_preview_render_ascii (CcDisplayConfig *config,
+                                        CcDisplayLayoutMode layout_mode,
+                                        int columns);
+
+#endif /* _CC_DISPLAY_PREVIEW_H */
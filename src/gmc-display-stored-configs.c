@@ -0,0 +1,824 @@
+/*
+ * Copyright (C) 2026  The gnome-monitor-config authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "gmc-display-stored-configs.h"
+
+#include <math.h>
+#include <string.h>
+
+/* Refresh rates are stored with three decimals */
+#define REFRESH_RATE_TOLERANCE 0.01
+
+typedef struct _MonitorSpec
+{
+  /* Interned, like the identity strings of CcDisplayMonitor */
+  const char *connector;
+  const char *vendor;
+  const char *product;
+  const char *serial;
+} MonitorSpec;
+
+typedef struct _StoredMonitor
+{
+  MonitorSpec *spec;
+  int width;
+  int height;
+  double refresh_rate;
+  gboolean is_interlaced;
+} StoredMonitor;
+
+typedef struct _StoredLogicalMonitor
+{
+  int x;
+  int y;
+  double scale;
+  CcDisplayTransform rotation;
+  gboolean is_flipped;
+  gboolean is_primary;
+  GList *monitors;
+} StoredLogicalMonitor;
+
+struct _CcDisplayStoredConfig
+{
+  GList *logical_monitors;
+  GList *disabled_specs;
+
+  gboolean layout_mode_set;
+  CcDisplayLayoutMode layout_mode;
+
+  char *monitors_key;
+  GPtrArray *connectors;
+};
+
+struct _CcDisplayStoredConfigs
+{
+  /* In file order */
+  GPtrArray *configs;
+
+  /* Monitor set key -> CcDisplayStoredConfig; later entries win */
+  GHashTable *index;
+};
+
+typedef struct _ParserData
+{
+  CcDisplayStoredConfigs *stored_configs;
+
+  GPtrArray *element_stack;
+  GString *text;
+
+  CcDisplayStoredConfig *config;
+  StoredLogicalMonitor *logical_monitor;
+  StoredMonitor *monitor;
+  MonitorSpec *spec;
+} ParserData;
+
+static void
+monitor_spec_free (MonitorSpec *spec)
+{
+  g_free (spec);
+}
+
+static void
+stored_monitor_free (StoredMonitor *monitor)
+{
+  g_clear_pointer (&monitor->spec, monitor_spec_free);
+  g_free (monitor);
+}
+
+static void
+stored_logical_monitor_free (StoredLogicalMonitor *logical_monitor)
+{
+  g_list_free_full (logical_monitor->monitors,
+                    (GDestroyNotify) stored_monitor_free);
+  g_free (logical_monitor);
+}
+
+static void
+stored_config_free (CcDisplayStoredConfig *config)
+{
+  g_list_free_full (config->logical_monitors,
+                    (GDestroyNotify) stored_logical_monitor_free);
+  g_list_free_full (config->disabled_specs,
+                    (GDestroyNotify) monitor_spec_free);
+  g_free (config->monitors_key);
+  g_clear_pointer (&config->connectors, g_ptr_array_unref);
+  g_free (config);
+}
+
+static char *
+monitor_spec_to_key_string (const char *connector,
+                            const char *vendor,
+                            const char *product,
+                            const char *serial)
+{
+  return g_strdup_printf ("%s\t%s\t%s\t%s", connector, vendor, product, serial);
+}
+
+static int
+compare_strings (gconstpointer a,
+                 gconstpointer b)
+{
+  return strcmp (*(const char **) a, *(const char **) b);
+}
+
+/*
+ * Identifies a set of monitors independently of their order, the same way
+ * Mutter keys its stored configurations. Takes ownership of @spec_strings.
+ */
+static char *
+create_monitors_key (GPtrArray *spec_strings)
+{
+  GString *key;
+  unsigned int i;
+
+  g_ptr_array_sort (spec_strings, compare_strings);
+
+  key = g_string_new (NULL);
+  for (i = 0; i < spec_strings->len; i++)
+    {
+      if (i > 0)
+        g_string_append_c (key, '\n');
+      g_string_append (key, g_ptr_array_index (spec_strings, i));
+    }
+
+  g_ptr_array_unref (spec_strings);
+
+  return g_string_free (key, FALSE);
+}
+
+static void
+add_spec (GPtrArray *spec_strings,
+          GPtrArray *connectors,
+          MonitorSpec *spec)
+{
+  g_ptr_array_add (spec_strings,
+                   monitor_spec_to_key_string (spec->connector,
+                                               spec->vendor,
+                                               spec->product,
+                                               spec->serial));
+  g_ptr_array_add (connectors, g_strdup (spec->connector));
+}
+
+static gboolean
+finish_stored_config (CcDisplayStoredConfig *config)
+{
+  GPtrArray *spec_strings;
+  GList *l;
+
+  if (!config->logical_monitors)
+    return FALSE;
+
+  spec_strings = g_ptr_array_new_with_free_func (g_free);
+  config->connectors = g_ptr_array_new_with_free_func (g_free);
+
+  for (l = config->logical_monitors; l; l = l->next)
+    {
+      StoredLogicalMonitor *logical_monitor = l->data;
+      GList *k;
+
+      if (!logical_monitor->monitors)
+        goto invalid;
+
+      for (k = logical_monitor->monitors; k; k = k->next)
+        {
+          StoredMonitor *monitor = k->data;
+
+          if (!monitor->spec)
+            goto invalid;
+
+          add_spec (spec_strings, config->connectors, monitor->spec);
+        }
+    }
+
+  for (l = config->disabled_specs; l; l = l->next)
+    add_spec (spec_strings, config->connectors, l->data);
+
+  config->monitors_key = create_monitors_key (spec_strings);
+
+  return TRUE;
+
+invalid:
+  g_ptr_array_unref (spec_strings);
+  return FALSE;
+}
+
+static const char *
+get_parent_element (ParserData *parser_data,
+                    unsigned int generation)
+{
+  GPtrArray *element_stack = parser_data->element_stack;
+
+  if (element_stack->len <= generation)
+    return "";
+
+  return g_ptr_array_index (element_stack,
+                            element_stack->len - 1 - generation);
+}
+
+static gboolean
+parse_int (const char *text,
+           int *value,
+           GError **error)
+{
+  gint64 parsed_value;
+
+  if (!g_ascii_string_to_signed (text, 10, G_MININT32, G_MAXINT32,
+                                 &parsed_value, error))
+    return FALSE;
+
+  *value = parsed_value;
+  return TRUE;
+}
+
+static gboolean
+parse_double (const char *text,
+              double *value,
+              GError **error)
+{
+  char *end;
+
+  *value = g_ascii_strtod (text, &end);
+  if (end == text || *end != '\0')
+    {
+      g_set_error (error, G_MARKUP_ERROR, G_MARKUP_ERROR_INVALID_CONTENT,
+                   "Invalid number '%s'", text);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+parse_bool (const char *text,
+            gboolean *value,
+            GError **error)
+{
+  if (g_str_equal (text, "yes"))
+    *value = TRUE;
+  else if (g_str_equal (text, "no"))
+    *value = FALSE;
+  else
+    {
+      g_set_error (error, G_MARKUP_ERROR, G_MARKUP_ERROR_INVALID_CONTENT,
+                   "Invalid boolean '%s'", text);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+handle_start_element (GMarkupParseContext *context,
+                      const char *element_name,
+                      const char **attribute_names,
+                      const char **attribute_values,
+                      gpointer user_data,
+                      GError **error)
+{
+  ParserData *parser_data = user_data;
+  const char *parent;
+
+  parent = get_parent_element (parser_data, 0);
+  g_ptr_array_add (parser_data->element_stack,
+                   (gpointer) g_intern_string (element_name));
+  g_string_truncate (parser_data->text, 0);
+
+  if (parser_data->element_stack->len == 1)
+    {
+      const char *version = NULL;
+      int i;
+
+      if (!g_str_equal (element_name, "monitors"))
+        {
+          g_set_error (error, G_MARKUP_ERROR, G_MARKUP_ERROR_INVALID_CONTENT,
+                       "Unexpected root element <%s>", element_name);
+          return;
+        }
+
+      for (i = 0; attribute_names[i]; i++)
+        {
+          if (g_str_equal (attribute_names[i], "version"))
+            version = attribute_values[i];
+        }
+
+      if (g_strcmp0 (version, "2") != 0)
+        {
+          g_set_error (error, G_MARKUP_ERROR, G_MARKUP_ERROR_INVALID_CONTENT,
+                       "Unsupported monitors.xml version %s",
+                       version ? version : "(none)");
+        }
+    }
+  else if (g_str_equal (element_name, "configuration") &&
+           g_str_equal (parent, "monitors"))
+    {
+      parser_data->config = g_new0 (CcDisplayStoredConfig, 1);
+    }
+  else if (g_str_equal (element_name, "logicalmonitor") &&
+           parser_data->config)
+    {
+      parser_data->logical_monitor = g_new0 (StoredLogicalMonitor, 1);
+      parser_data->logical_monitor->scale = 1.0;
+    }
+  else if (g_str_equal (element_name, "monitor") &&
+           parser_data->logical_monitor)
+    {
+      parser_data->monitor = g_new0 (StoredMonitor, 1);
+    }
+  else if (g_str_equal (element_name, "monitorspec") &&
+           parser_data->config)
+    {
+      parser_data->spec = g_new0 (MonitorSpec, 1);
+    }
+}
+
+static gboolean
+handle_monitor_spec_element (ParserData *parser_data,
+                             const char *element_name,
+                             const char *text)
+{
+  MonitorSpec *spec = parser_data->spec;
+  const char **field;
+
+  if (g_str_equal (element_name, "connector"))
+    field = &spec->connector;
+  else if (g_str_equal (element_name, "vendor"))
+    field = &spec->vendor;
+  else if (g_str_equal (element_name, "product"))
+    field = &spec->product;
+  else if (g_str_equal (element_name, "serial"))
+    field = &spec->serial;
+  else
+    return TRUE;
+
+  *field = g_intern_string (text);
+
+  return TRUE;
+}
+
+static gboolean
+handle_logical_monitor_element (ParserData *parser_data,
+                                const char *element_name,
+                                const char *text,
+                                GError **error)
+{
+  StoredLogicalMonitor *logical_monitor = parser_data->logical_monitor;
+
+  if (g_str_equal (element_name, "x"))
+    return parse_int (text, &logical_monitor->x, error);
+  else if (g_str_equal (element_name, "y"))
+    return parse_int (text, &logical_monitor->y, error);
+  else if (g_str_equal (element_name, "scale"))
+    return parse_double (text, &logical_monitor->scale, error);
+  else if (g_str_equal (element_name, "primary"))
+    return parse_bool (text, &logical_monitor->is_primary, error);
+
+  return TRUE;
+}
+
+static gboolean
+handle_transform_element (ParserData *parser_data,
+                          const char *element_name,
+                          const char *text,
+                          GError **error)
+{
+  StoredLogicalMonitor *logical_monitor = parser_data->logical_monitor;
+
+  if (g_str_equal (element_name, "flipped"))
+    return parse_bool (text, &logical_monitor->is_flipped, error);
+
+  if (!g_str_equal (element_name, "rotation"))
+    return TRUE;
+
+  if (g_str_equal (text, "normal"))
+    logical_monitor->rotation = CC_DISPLAY_TRANSFORM_NORMAL;
+  else if (g_str_equal (text, "left"))
+    logical_monitor->rotation = CC_DISPLAY_TRANSFORM_90;
+  else if (g_str_equal (text, "upside_down"))
+    logical_monitor->rotation = CC_DISPLAY_TRANSFORM_180;
+  else if (g_str_equal (text, "right"))
+    logical_monitor->rotation = CC_DISPLAY_TRANSFORM_270;
+  else
+    {
+      g_set_error (error, G_MARKUP_ERROR, G_MARKUP_ERROR_INVALID_CONTENT,
+                   "Invalid rotation '%s'", text);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+handle_mode_element (ParserData *parser_data,
+                     const char *element_name,
+                     const char *text,
+                     GError **error)
+{
+  StoredMonitor *monitor = parser_data->monitor;
+
+  if (g_str_equal (element_name, "width"))
+    return parse_int (text, &monitor->width, error);
+  else if (g_str_equal (element_name, "height"))
+    return parse_int (text, &monitor->height, error);
+  else if (g_str_equal (element_name, "rate"))
+    return parse_double (text, &monitor->refresh_rate, error);
+  else if (g_str_equal (element_name, "flag"))
+    monitor->is_interlaced = g_str_equal (text, "interlace");
+
+  return TRUE;
+}
+
+static void
+add_stored_config (CcDisplayStoredConfigs *stored_configs,
+                   CcDisplayStoredConfig *config)
+{
+  if (!finish_stored_config (config))
+    {
+      stored_config_free (config);
+      return;
+    }
+
+  g_ptr_array_add (stored_configs->configs, config);
+  g_hash_table_replace (stored_configs->index, config->monitors_key, config);
+}
+
+static void
+handle_end_element (GMarkupParseContext *context,
+                    const char *element_name,
+                    gpointer user_data,
+                    GError **error)
+{
+  ParserData *parser_data = user_data;
+  const char *parent;
+  const char *text;
+
+  parent = get_parent_element (parser_data, 1);
+  text = g_strstrip (parser_data->text->str);
+
+  if (g_str_equal (element_name, "configuration") && parser_data->config)
+    {
+      add_stored_config (parser_data->stored_configs,
+                         g_steal_pointer (&parser_data->config));
+    }
+  else if (g_str_equal (element_name, "logicalmonitor") &&
+           parser_data->logical_monitor)
+    {
+      parser_data->config->logical_monitors =
+        g_list_append (parser_data->config->logical_monitors,
+                       g_steal_pointer (&parser_data->logical_monitor));
+    }
+  else if (g_str_equal (element_name, "monitor") && parser_data->monitor)
+    {
+      parser_data->logical_monitor->monitors =
+        g_list_append (parser_data->logical_monitor->monitors,
+                       g_steal_pointer (&parser_data->monitor));
+    }
+  else if (g_str_equal (element_name, "monitorspec") && parser_data->spec)
+    {
+      if (g_str_equal (parent, "monitor") && parser_data->monitor)
+        {
+          g_clear_pointer (&parser_data->monitor->spec, monitor_spec_free);
+          parser_data->monitor->spec = g_steal_pointer (&parser_data->spec);
+        }
+      else if (g_str_equal (parent, "disabled"))
+        {
+          parser_data->config->disabled_specs =
+            g_list_append (parser_data->config->disabled_specs,
+                           g_steal_pointer (&parser_data->spec));
+        }
+      else
+        {
+          g_clear_pointer (&parser_data->spec, monitor_spec_free);
+        }
+    }
+  else if (g_str_equal (parent, "monitorspec") && parser_data->spec)
+    {
+      handle_monitor_spec_element (parser_data, element_name, text);
+    }
+  else if (g_str_equal (parent, "logicalmonitor") &&
+           parser_data->logical_monitor)
+    {
+      if (!handle_logical_monitor_element (parser_data, element_name, text,
+                                           error))
+        return;
+    }
+  else if (g_str_equal (parent, "transform") &&
+           parser_data->logical_monitor)
+    {
+      if (!handle_transform_element (parser_data, element_name, text, error))
+        return;
+    }
+  else if (g_str_equal (parent, "mode") && parser_data->monitor)
+    {
+      if (!handle_mode_element (parser_data, element_name, text, error))
+        return;
+    }
+  else if (g_str_equal (element_name, "layoutmode") &&
+           g_str_equal (parent, "configuration") &&
+           parser_data->config)
+    {
+      if (g_str_equal (text, "logical"))
+        parser_data->config->layout_mode = CC_DISPLAY_LAYOUT_MODE_LOGICAL;
+      else if (g_str_equal (text, "physical"))
+        parser_data->config->layout_mode = CC_DISPLAY_LAYOUT_MODE_PHYSICAL;
+      else
+        {
+          g_set_error (error, G_MARKUP_ERROR, G_MARKUP_ERROR_INVALID_CONTENT,
+                       "Invalid layout mode '%s'", text);
+          return;
+        }
+      parser_data->config->layout_mode_set = TRUE;
+    }
+
+  g_ptr_array_set_size (parser_data->element_stack,
+                        parser_data->element_stack->len - 1);
+  g_string_truncate (parser_data->text, 0);
+}
+
+static void
+handle_text (GMarkupParseContext *context,
+             const char *text,
+             gsize text_len,
+             gpointer user_data,
+             GError **error)
+{
+  ParserData *parser_data = user_data;
+
+  g_string_append_len (parser_data->text, text, text_len);
+}
+
+static const GMarkupParser stored_configs_parser = {
+  .start_element = handle_start_element,
+  .end_element = handle_end_element,
+  .text = handle_text,
+};
+
+static void
+clear_parser_data (ParserData *parser_data)
+{
+  g_clear_pointer (&parser_data->spec, monitor_spec_free);
+  g_clear_pointer (&parser_data->monitor, stored_monitor_free);
+  g_clear_pointer (&parser_data->logical_monitor, stored_logical_monitor_free);
+  g_clear_pointer (&parser_data->config, stored_config_free);
+  g_ptr_array_unref (parser_data->element_stack);
+  g_string_free (parser_data->text, TRUE);
+}
+
+char *
+cc_display_stored_configs_get_default_path (void)
+{
+  return g_build_filename (g_get_user_config_dir (), "monitors.xml", NULL);
+}
+
+/*
+ * Parses @path in a single pass, indexing every configuration by the set of
+ * monitors it is for, so that finding the one for the connected monitors
+ * does not depend on the number of stored entries. Entries Mutter itself
+ * would not be able to use are skipped.
+ */
+CcDisplayStoredConfigs *
+cc_display_stored_configs_new_from_file (const char *path,
+                                         GError **error)
+{
+  g_autoptr(CcDisplayStoredConfigs) stored_configs = NULL;
+  g_autoptr(GMappedFile) mapped_file = NULL;
+  GMarkupParseContext *parse_context;
+  ParserData parser_data;
+  gboolean ret;
+
+  mapped_file = g_mapped_file_new (path, FALSE, error);
+  if (!mapped_file)
+    return NULL;
+
+  stored_configs = g_new0 (CcDisplayStoredConfigs, 1);
+  stored_configs->configs =
+    g_ptr_array_new_with_free_func ((GDestroyNotify) stored_config_free);
+  stored_configs->index = g_hash_table_new (g_str_hash, g_str_equal);
+
+  parser_data = (ParserData) {
+    .stored_configs = stored_configs,
+    .element_stack = g_ptr_array_new (),
+    .text = g_string_new (NULL),
+  };
+
+  parse_context = g_markup_parse_context_new (&stored_configs_parser,
+                                              G_MARKUP_PREFIX_ERROR_POSITION,
+                                              &parser_data, NULL);
+  ret = (g_markup_parse_context_parse (parse_context,
+                                       g_mapped_file_get_contents (mapped_file),
+                                       g_mapped_file_get_length (mapped_file),
+                                       error) &&
+         g_markup_parse_context_end_parse (parse_context, error));
+  g_markup_parse_context_free (parse_context);
+  clear_parser_data (&parser_data);
+
+  if (!ret)
+    {
+      g_prefix_error (error, "Failed to parse %s: ", path);
+      return NULL;
+    }
+
+  return g_steal_pointer (&stored_configs);
+}
+
+void
+cc_display_stored_configs_free (CcDisplayStoredConfigs *stored_configs)
+{
+  g_hash_table_destroy (stored_configs->index);
+  g_ptr_array_unref (stored_configs->configs);
+  g_free (stored_configs);
+}
+
+unsigned int
+cc_display_stored_configs_get_n_configs (CcDisplayStoredConfigs *stored_configs)
+{
+  return stored_configs->configs->len;
+}
+
+CcDisplayStoredConfig *
+cc_display_stored_configs_get_config (CcDisplayStoredConfigs *stored_configs,
+                                      unsigned int index)
+{
+  g_return_val_if_fail (index < stored_configs->configs->len, NULL);
+
+  return g_ptr_array_index (stored_configs->configs, index);
+}
+
+CcDisplayStoredConfig *
+cc_display_stored_configs_lookup (CcDisplayStoredConfigs *stored_configs,
+                                  CcDisplayState *state)
+{
+  g_autofree char *monitors_key = NULL;
+  GPtrArray *spec_strings;
+  GList *l;
+
+  spec_strings = g_ptr_array_new_with_free_func (g_free);
+  for (l = cc_display_state_get_monitors (state); l; l = l->next)
+    {
+      CcDisplayMonitor *monitor = l->data;
+
+      g_ptr_array_add (spec_strings,
+                       monitor_spec_to_key_string (cc_display_monitor_get_connector (monitor),
+                                                   cc_display_monitor_get_vendor (monitor),
+                                                   cc_display_monitor_get_product (monitor),
+                                                   cc_display_monitor_get_serial (monitor)));
+    }
+  monitors_key = create_monitors_key (spec_strings);
+
+  return g_hash_table_lookup (stored_configs->index, monitors_key);
+}
+
+GPtrArray *
+cc_display_stored_config_get_connectors (CcDisplayStoredConfig *stored_config)
+{
+  return stored_config->connectors;
+}
+
+unsigned int
+cc_display_stored_config_get_n_logical_monitors (CcDisplayStoredConfig *stored_config)
+{
+  return g_list_length (stored_config->logical_monitors);
+}
+
+static CcDisplayMonitor *
+find_monitor (CcDisplayState *state,
+              MonitorSpec *spec)
+{
+  GList *l;
+
+  for (l = cc_display_state_get_monitors (state); l; l = l->next)
+    {
+      CcDisplayMonitor *monitor = l->data;
+
+      if (cc_display_monitor_get_connector (monitor) == spec->connector &&
+          cc_display_monitor_get_vendor (monitor) == spec->vendor &&
+          cc_display_monitor_get_product (monitor) == spec->product &&
+          cc_display_monitor_get_serial (monitor) == spec->serial)
+        return monitor;
+    }
+
+  return NULL;
+}
+
+static CcDisplayMode *
+find_mode (CcDisplayMonitor *monitor,
+           StoredMonitor *stored_monitor)
+{
+  CcDisplayMode *best_mode = NULL;
+  double best_difference = REFRESH_RATE_TOLERANCE;
+  GList *l;
+
+  for (l = cc_display_monitor_get_modes (monitor); l; l = l->next)
+    {
+      CcDisplayMode *mode = l->data;
+      int width, height;
+      double difference;
+
+      cc_display_mode_get_resolution (mode, &width, &height);
+      if (width != stored_monitor->width ||
+          height != stored_monitor->height ||
+          cc_display_mode_is_interlaced (mode) != stored_monitor->is_interlaced)
+        continue;
+
+      difference = fabs (cc_display_mode_get_refresh_rate (mode) -
+                         stored_monitor->refresh_rate);
+      if (difference <= best_difference)
+        {
+          best_mode = mode;
+          best_difference = difference;
+        }
+    }
+
+  return best_mode;
+}
+
+/*
+ * Resolves the stored monitor specs and modes against @state. Fails if a
+ * monitor is not connected or no longer offers the stored mode.
+ */
+CcDisplayConfig *
+cc_display_stored_config_create_config (CcDisplayStoredConfig *stored_config,
+                                        CcDisplayState *state,
+                                        GError **error)
+{
+  g_autoptr(CcDisplayConfig) config = NULL;
+  GList *l;
+
+  config = cc_display_config_new ();
+  if (stored_config->layout_mode_set)
+    cc_display_config_set_layout_mode (config, stored_config->layout_mode);
+
+  for (l = stored_config->logical_monitors; l; l = l->next)
+    {
+      StoredLogicalMonitor *stored_logical_monitor = l->data;
+      g_autoptr(CcDisplayLogicalMonitorConfig) logical_monitor_config = NULL;
+      CcDisplayTransform transform;
+      GList *k;
+
+      transform = stored_logical_monitor->rotation;
+      if (stored_logical_monitor->is_flipped)
+        transform += CC_DISPLAY_TRANSFORM_FLIPPED;
+
+      logical_monitor_config = cc_display_logical_monitor_config_new ();
+      cc_display_logical_monitor_config_set_position (logical_monitor_config,
+                                                      stored_logical_monitor->x,
+                                                      stored_logical_monitor->y);
+      cc_display_logical_monitor_config_set_scale (logical_monitor_config,
+                                                   stored_logical_monitor->scale);
+      cc_display_logical_monitor_config_set_transform (logical_monitor_config,
+                                                       transform);
+      cc_display_logical_monitor_config_set_is_primary (logical_monitor_config,
+                                                        stored_logical_monitor->is_primary);
+
+      for (k = stored_logical_monitor->monitors; k; k = k->next)
+        {
+          StoredMonitor *stored_monitor = k->data;
+          CcDisplayMonitor *monitor;
+          CcDisplayMode *mode;
+
+          monitor = find_monitor (state, stored_monitor->spec);
+          if (!monitor)
+            {
+              g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                           "Monitor %s is not connected",
+                           stored_monitor->spec->connector);
+              return NULL;
+            }
+
+          mode = find_mode (monitor, stored_monitor);
+          if (!mode)
+            {
+              g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                           "Monitor %s has no mode %dx%d@%g",
+                           stored_monitor->spec->connector,
+                           stored_monitor->width,
+                           stored_monitor->height,
+                           stored_monitor->refresh_rate);
+              return NULL;
+            }
+
+          cc_display_logical_monitor_config_add_monitor (logical_monitor_config,
+                                                         monitor, mode);
+        }
+
+      cc_display_config_add_logical_monitor (config,
+                                             g_steal_pointer (&logical_monitor_config));
+    }
+
+  return g_steal_pointer (&config);
+}
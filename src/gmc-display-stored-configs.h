@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2026  The gnome-monitor-config authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _CC_DISPLAY_STORED_CONFIGS_H
+#define _CC_DISPLAY_STORED_CONFIGS_H
+
+#include <glib.h>
+
+#include "gmc-display-config.h"
+
+/* The configurations Mutter persisted in monitors.xml */
+typedef struct _CcDisplayStoredConfigs CcDisplayStoredConfigs;
+typedef struct _CcDisplayStoredConfig CcDisplayStoredConfig;
+
+char * cc_display_stored_configs_get_default_path (void);
+
+CcDisplayStoredConfigs * cc_display_stored_configs_new_from_file (const char *path,
+                                                                  GError **error);
+void cc_display_stored_configs_free (CcDisplayStoredConfigs *stored_configs);
+
+unsigned int cc_display_stored_configs_get_n_configs (CcDisplayStoredConfigs *stored_configs);
+CcDisplayStoredConfig * cc_display_stored_configs_get_config (CcDisplayStoredConfigs *stored_configs,
+                                                              unsigned int index);
+
+/*
+ * Returns the configuration stored for exactly the monitors connected in
+ * @state, or NULL.
+ */
+CcDisplayStoredConfig * cc_display_stored_configs_lookup (CcDisplayStoredConfigs *stored_configs,
+                                                          CcDisplayState *state);
+
+/* Connectors of all monitors the configuration is for, including disabled ones */
+GPtrArray * cc_display_stored_config_get_connectors (CcDisplayStoredConfig *stored_config);
+unsigned int cc_display_stored_config_get_n_logical_monitors (CcDisplayStoredConfig *stored_config);
+
+CcDisplayConfig * cc_display_stored_config_create_config (CcDisplayStoredConfig *stored_config,
+                                                          CcDisplayState *state,
+                                                          GError **error);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (CcDisplayStoredConfigs, cc_display_stored_configs_free)
+
+#endif /* _CC_DISPLAY_STORED_CONFIGS_H */
@@ -23,12 +23,24 @@
 
 #include <errno.h>
 #include <getopt.h>
+#include <glib-unix.h>
+#include <glib/gstdio.h>
+#include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include "gmc-display-config-manager.h"
+#include "gmc-display-filter.h"
+#include "gmc-display-preview.h"
+#include "gmc-display-stored-configs.h"
+
+static const char *state_file = NULL;
+static GPtrArray *bus_addresses = NULL;
+static gboolean wait_for_compositor = FALSE;
+static int wait_timeout_ms = -1;
 
 static CcDisplayState *current_state = NULL;
 
@@ -37,6 +49,10 @@ static gboolean pending_layout_mode_set = FALSE;
 static CcDisplayLayoutMode pending_layout_mode = CC_DISPLAY_LAYOUT_MODE_LOGICAL;
 static CcDisplayLogicalMonitorConfig *pending_logical_monitor_config = NULL;
 static CcDisplayMonitor *current_monitor;
+static CcDisplayMonitorConfig *current_monitor_config;
+static gboolean patch_mode = FALSE;
+static gboolean patch_positions_given = FALSE;
+static CcDisplayLogicalMonitorConfig *patched_logical_monitor_config;
 static int pending_logical_monitor_x;
 static int pending_logical_monitor_y;
 static double pending_logical_monitor_scale;
@@ -55,11 +71,39 @@ print_help (void)
   print_usage (stdout);
   printf ("Options:\n"
           " -h, --help                  Print help text\n"
+          " --state-from=FILE           Read the display state from a file saved with\n"
+          "                             'list --save-state' instead of the compositor\n"
+          " --bus=ADDRESS               Apply 'set' on the session bus at ADDRESS; may be\n"
+          "                             given multiple times to configure several seats\n"
+          " --all-sessions              Apply 'set' on every session bus in /run/user\n"
+          " --verbose                   Print debug messages, such as the configuration\n"
+          "                             sent to the compositor\n"
+          " --wait[=TIMEOUT]            Wait until the compositor is running, at most\n"
+          "                             TIMEOUT seconds if given, and report the wait;\n"
+          "                             with several buses, TIMEOUT is required\n"
           "\n"
           "Commands:\n"
           "  list                       List current monitors and current configuration\n"
           "  set                        Set new configuration\n"
           "  show                       Show monitor labels\n"
+          "  power                      Change or query the power save mode\n"
+          "  list-stored [FILE]         List the configurations stored in monitors.xml\n"
+          "  apply-stored [FILE]        Apply the stored configuration for the\n"
+          "                             connected monitors\n"
+          "  preview-batch FILE         Preview the layout of each line of 'set'\n"
+          "                             options in FILE\n"
+          "  confirm                    Keep a configuration applied with\n"
+          "                             'set --confirm-within'\n"
+          "  watch                      Print the state whenever monitors changed\n"
+          "  locate X Y [WIDTH HEIGHT]  Print the logical monitor at X,Y, or those\n"
+          "                             intersecting the given rect\n"
+          "\n"
+          "Options for 'list':\n"
+          " --save-state=FILE           Save the display state to FILE\n"
+          " --filter=EXPR               Only list the modes matching EXPR, e.g.\n"
+          "                             'connector=DP-* && width>=3840 && refresh>=120'\n"
+          " --fields=LIST               Print the comma separated fields LIST of each\n"
+          "                             mode, one mode per line (default: connector,id)\n"
           "\n"
           "Options for 'set':\n"
           " -L, --logical-monitor       Add logical monitor\n"
@@ -68,12 +112,49 @@ print_help (void)
           " -s, --scale=SCALE           Set scale of newly added logical monitor\n"
           " -t, --transform=TRANSFORM   Set transform (normal, left, right, flip)\n"
           " -p, --primary               Mark the newly added logical monitor as primary\n"
-          " -m, --mode                  Set the display resolution and refresh rate. ex: 1920x1080@60\n"
-          " -M, --monitor=CONNECTOR     Add a monitor (given its connector) to newly added\n"
-          "                             logical monitor\n"
+          " -m, --mode=MODE             Set the display resolution and refresh rate, either\n"
+          "                             as a mode id (ex: 1920x1080@60.000) or as one of\n"
+          "                             highest-refresh, max-resolution (or max),\n"
+          "                             native, WxH@max\n"
+          " -M, --monitor=MONITOR       Add a monitor to newly added logical monitor,\n"
+          "                             given its connector, vendor:product:serial\n"
+          "                             identity, display name, 'builtin', or a glob\n"
+          "                             pattern matching exactly one of those\n"
           " -p, --primary               Mark the newly added logical monitor as primary\n"
           " --logical-layout-mode       Set logical layout mode\n"
           " --physical-layout-mode      Set physical layout mode\n"
+          " --patch                     Start from the current configuration; -M then\n"
+          "                             selects a monitor whose logical monitor the\n"
+          "                             following options change. Must come first\n"
+          " --off                       Turn off the monitor selected with -M (--patch)\n"
+          " --dry-run                   Print the configuration without applying it\n"
+          " --verify                    Only check whether the compositor accepts the\n"
+          "                             configuration; results are cached\n"
+          " --sync-refresh              Pick the modes at the configured resolutions whose\n"
+          "                             refresh rates are closest across all monitors\n"
+          " --preview=FILE.png|ascii    Render the layout to a PNG file or the terminal\n"
+          "                             instead of applying it\n"
+          " --confirm-within=SECONDS    Revert to the previous configuration unless\n"
+          "                             Enter is pressed or 'confirm' is run in time\n"
+          "\n"
+          "Options for 'preview-batch':\n"
+          " --format=png|ascii          Render PNG files (default) or text diagrams\n"
+          " --output-dir=DIR            Write layout-NNN.png files to DIR (default: .)\n"
+          "\n"
+          "Options for 'watch':\n"
+          " --quiet-period=MS           Wait until monitors didn't change for MS\n"
+          "                             milliseconds (default: 250)\n"
+          " --max-delay=MS              But no longer than MS milliseconds after the\n"
+          "                             first change (default: 2000)\n"
+          "\n"
+          "Options for 'apply-stored':\n"
+          " --dry-run                   Print the configuration without applying it\n"
+          " --persistent                Apply the configuration persistently\n"
+          "\n"
+          "Options for 'power':\n"
+          " on, standby, suspend, off   Set the power save mode and report how long\n"
+          "                             it took until the change was confirmed\n"
+          " --status                    Print the current power save mode\n"
           );
 }
 
@@ -162,22 +243,180 @@ transform_to_str (CcDisplayTransform transform)
   g_assert_not_reached ();
 }
 
+static const char *
+power_save_mode_to_str (CcDisplayPowerSaveMode mode)
+{
+  switch (mode)
+    {
+    case CC_DISPLAY_POWER_SAVE_MODE_UNKNOWN:
+      return "unknown";
+    case CC_DISPLAY_POWER_SAVE_MODE_ON:
+      return "on";
+    case CC_DISPLAY_POWER_SAVE_MODE_STANDBY:
+      return "standby";
+    case CC_DISPLAY_POWER_SAVE_MODE_SUSPEND:
+      return "suspend";
+    case CC_DISPLAY_POWER_SAVE_MODE_OFF:
+      return "off";
+    }
+
+  return "unknown";
+}
+
+/*
+ * Fetches the current state from the compositor, or from the file given with
+ * --state-from, in which case no manager is created.
+ */
+static GVariant *
+fetch_current_state_variant (CcDisplayConfigManager **config_manager,
+                             GError **error)
+{
+  if (state_file)
+    return cc_display_state_variant_new_from_file (state_file, error);
+
+  *config_manager =
+    cc_display_config_manager_new_with_flags (CC_DISPLAY_CONFIG_MANAGER_FLAGS_ONE_SHOT,
+                                              error);
+  if (!*config_manager)
+    return NULL;
+
+  return cc_display_config_manager_get_current_state_variant (*config_manager,
+                                                              error);
+}
+
+static CcDisplayState *
+fetch_current_state (CcDisplayConfigManager **config_manager,
+                     GError **error)
+{
+  g_autoptr(GVariant) state_variant = NULL;
+
+  state_variant = fetch_current_state_variant (config_manager, error);
+  if (!state_variant)
+    return NULL;
+
+  return cc_display_state_new_from_variant (state_variant, error);
+}
+
+/*
+ * Goes through the mode table of the state, so the filter runs on every mode
+ * without formatting anything, and only the matching rows are printed.
+ */
+static void
+list_filtered_modes (CcDisplayState *state,
+                     CcDisplayFilter *filter,
+                     CcDisplayFieldList *field_list)
+{
+  g_autoptr(GString) row = NULL;
+  g_autofree unsigned int *rows = NULL;
+  unsigned int n_rows;
+  unsigned int i;
+
+  n_rows = cc_display_state_get_n_modes (state);
+  rows = g_new (unsigned int, MAX (n_rows, 1));
+  if (filter)
+    {
+      n_rows = cc_display_filter_find_modes (filter, state, rows);
+    }
+  else
+    {
+      for (i = 0; i < n_rows; i++)
+        rows[i] = i;
+    }
+
+  row = g_string_new (NULL);
+  for (i = 0; i < n_rows; i++)
+    {
+      g_string_truncate (row, 0);
+      cc_display_field_list_append_row (field_list,
+                                        cc_display_state_get_mode_monitor (state,
+                                                                           rows[i]),
+                                        cc_display_state_get_mode (state, rows[i]),
+                                        row);
+      g_print ("%s\n", row->str);
+    }
+}
+
 static gboolean
-list_monitors (GError **error)
+list_monitors (int argc,
+               char **argv,
+               GError **error)
 {
-  CcDisplayConfigManager *config_manager;
-  CcDisplayState *state;
+  struct option options[] = {
+    { "save-state", required_argument, 0, 'S' },
+    { "filter", required_argument, 0, 'F' },
+    { "fields", required_argument, 0, 'f' },
+    { }
+  };
+  g_autoptr(CcDisplayConfigManager) config_manager = NULL;
+  g_autoptr(GVariant) state_variant = NULL;
+  g_autoptr(CcDisplayState) state = NULL;
+  g_autoptr(CcDisplayFilter) filter = NULL;
+  g_autoptr(CcDisplayFieldList) field_list = NULL;
+  const char *save_state_file = NULL;
+  const char *fields = NULL;
   GList *l;
   int max_screen_width, max_screen_height;
 
-  config_manager = cc_display_config_manager_new (error);
-  if (!config_manager)
+  while (true)
+    {
+      int c;
+
+      c = getopt_long (argc, argv, "", options, NULL);
+      if (c < 0)
+        break;
+
+      switch (c)
+        {
+        case 'S':
+          save_state_file = optarg;
+          break;
+
+        case 'F':
+          g_clear_pointer (&filter, cc_display_filter_free);
+          filter = cc_display_filter_new (optarg, error);
+          if (!filter)
+            return FALSE;
+          break;
+
+        case 'f':
+          fields = optarg;
+          break;
+
+        default:
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                       "Invalid option");
+          return FALSE;
+        }
+    }
+
+  if (filter || fields)
+    {
+      field_list = cc_display_field_list_new (fields ? fields : "connector,id",
+                                              error);
+      if (!field_list)
+        return FALSE;
+    }
+
+  state_variant = fetch_current_state_variant (&config_manager, error);
+  if (!state_variant)
+    return FALSE;
+
+  if (save_state_file &&
+      !cc_display_state_variant_save_to_file (state_variant,
+                                              save_state_file,
+                                              error))
     return FALSE;
 
-  state = cc_display_config_manager_new_current_state (config_manager, error);
+  state = cc_display_state_new_from_variant (state_variant, error);
   if (!state)
     return FALSE;
 
+  if (field_list)
+    {
+      list_filtered_modes (state, filter, field_list);
+      return TRUE;
+    }
+
   for (l = cc_display_state_get_monitors (state); l; l = l->next)
     {
       CcDisplayMonitor *monitor = l->data;
@@ -185,6 +424,7 @@ list_monitors (GError **error)
       bool is_active = cc_display_monitor_is_active (monitor);
       bool is_builtin_display = cc_display_monitor_is_builtin_display (monitor);
       const char *display_name = cc_display_monitor_get_display_name (monitor);
+      g_autofree char *identity = cc_display_monitor_dup_identity (monitor);
 
       g_print ("Monitor [ %s ] %s%s\n",
                connector,
@@ -192,6 +432,7 @@ list_monitors (GError **error)
                is_builtin_display ? " BUILTIN" : "");
       if (display_name)
         g_print ("  display-name: %s\n", display_name);
+      g_print ("  identity: %s\n", identity);
       list_modes (monitor);
     }
 
@@ -268,6 +509,9 @@ handle_logical_monitor_arg (GError **error)
     }
 
   pending_logical_monitor_config = cc_display_logical_monitor_config_new ();
+  patched_logical_monitor_config = NULL;
+  current_monitor = NULL;
+  current_monitor_config = NULL;
   pending_logical_monitor_x = 0;
   pending_logical_monitor_y = 0;
   pending_logical_monitor_scale = 1.0;
@@ -295,7 +539,22 @@ handle_logical_monitor_property_arg (int option,
             return FALSE;
           }
 
-        pending_logical_monitor_x = x;
+        if (patch_mode)
+          patch_positions_given = TRUE;
+
+        if (patched_logical_monitor_config)
+          {
+            int old_x, old_y;
+
+            cc_display_logical_monitor_config_get_position (patched_logical_monitor_config,
+                                                            &old_x, &old_y);
+            cc_display_logical_monitor_config_set_position (patched_logical_monitor_config,
+                                                            x, old_y);
+          }
+        else
+          {
+            pending_logical_monitor_x = x;
+          }
 
         break;
       }
@@ -312,7 +571,22 @@ handle_logical_monitor_property_arg (int option,
             return FALSE;
           }
 
-        pending_logical_monitor_y = y;
+        if (patch_mode)
+          patch_positions_given = TRUE;
+
+        if (patched_logical_monitor_config)
+          {
+            int old_x, old_y;
+
+            cc_display_logical_monitor_config_get_position (patched_logical_monitor_config,
+                                                            &old_x, &old_y);
+            cc_display_logical_monitor_config_set_position (patched_logical_monitor_config,
+                                                            old_x, y);
+          }
+        else
+          {
+            pending_logical_monitor_y = y;
+          }
 
         break;
       }
@@ -328,7 +602,11 @@ handle_logical_monitor_property_arg (int option,
             return FALSE;
           }
 
-        pending_logical_monitor_scale = scale;
+        if (patched_logical_monitor_config)
+          cc_display_logical_monitor_config_set_scale (patched_logical_monitor_config,
+                                                       scale);
+        else
+          pending_logical_monitor_scale = scale;
 
         break;
       }
@@ -359,7 +637,11 @@ handle_logical_monitor_property_arg (int option,
             return FALSE;
           }
 
-        pending_logical_monitor_transform = transform;
+        if (patched_logical_monitor_config)
+          cc_display_logical_monitor_config_set_transform (patched_logical_monitor_config,
+                                                           transform);
+        else
+          pending_logical_monitor_transform = transform;
         break;
       }
     default:
@@ -370,17 +652,38 @@ handle_logical_monitor_property_arg (int option,
   return TRUE;
 }
 
+static void
+unset_primary_logical_monitors (void)
+{
+  GList *l;
+
+  for (l = cc_display_config_get_logical_logical_monitor_configs (pending_config);
+       l;
+       l = l->next)
+    cc_display_logical_monitor_config_set_is_primary (l->data, FALSE);
+}
+
 static gboolean
 handle_logical_monitor_primary_arg (GError **error)
 {
-  if (!pending_logical_monitor_config)
+  CcDisplayLogicalMonitorConfig *logical_monitor_config;
+
+  if (pending_logical_monitor_config)
+    logical_monitor_config = pending_logical_monitor_config;
+  else
+    logical_monitor_config = patched_logical_monitor_config;
+
+  if (!logical_monitor_config)
     {
       g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
                    "Made primary without logical monitor");
       return FALSE;
     }
 
-  cc_display_logical_monitor_config_set_is_primary (pending_logical_monitor_config,
+  if (patch_mode)
+    unset_primary_logical_monitors ();
+
+  cc_display_logical_monitor_config_set_is_primary (logical_monitor_config,
                                                     TRUE);
 
   return TRUE;
@@ -402,32 +705,113 @@ add_monitor_with_preferred_mode (CcDisplayMonitor *monitor,
   mode = cc_display_monitor_get_preferred_mode (monitor);
   cc_display_logical_monitor_config_add_monitor (pending_logical_monitor_config,
                                                  monitor, mode);
+  current_monitor_config =
+    g_list_last (cc_display_logical_monitor_config_get_monitor_configs (pending_logical_monitor_config))->data;
 
   return TRUE;
 }
 
+static CcDisplayLayoutMode
+get_pending_layout_mode (void)
+{
+  CcDisplayLayoutMode layout_mode;
+
+  if (cc_display_config_get_layout_mode (pending_config, &layout_mode))
+    return layout_mode;
+
+  return cc_display_state_get_layout_mode (current_state);
+}
+
+/*
+ * Selects @monitor in the patched configuration. A monitor that is not enabled
+ * gets a logical monitor of its own to the right of the current layout.
+ */
+static void
+select_patched_monitor (CcDisplayMonitor *monitor)
+{
+  CcDisplayLogicalMonitorConfig *logical_monitor_config;
+  CcDisplayMode *mode;
+  GList *l;
+  int x = 0;
+
+  current_monitor_config =
+    cc_display_config_lookup_monitor_config (pending_config, monitor,
+                                             &patched_logical_monitor_config);
+  if (current_monitor_config)
+    return;
+
+  for (l = cc_display_config_get_logical_logical_monitor_configs (pending_config);
+       l;
+       l = l->next)
+    {
+      cairo_rectangle_int_t rect;
+
+      cc_display_logical_monitor_config_calculate_rect (l->data,
+                                                        get_pending_layout_mode (),
+                                                        &rect);
+      x = MAX (x, rect.x + rect.width);
+    }
+
+  logical_monitor_config = cc_display_logical_monitor_config_new ();
+  cc_display_logical_monitor_config_set_position (logical_monitor_config, x, 0);
+  cc_display_logical_monitor_config_set_scale (logical_monitor_config, 1.0);
+
+  mode = cc_display_monitor_get_preferred_mode (monitor);
+  cc_display_logical_monitor_config_add_monitor (logical_monitor_config,
+                                                 monitor, mode);
+  cc_display_config_add_logical_monitor (pending_config,
+                                         logical_monitor_config);
+
+  patched_logical_monitor_config = logical_monitor_config;
+  current_monitor_config =
+    cc_display_config_lookup_monitor_config (pending_config, monitor, NULL);
+}
+
 static gboolean
 handle_monitor_arg (const char *value,
                     GError **error)
 {
-  GList *l;
-  const char *connector = value;
+  CcDisplayMonitor *monitor;
 
-  for (l = cc_display_state_get_monitors (current_state); l; l = l->next)
-    {
-      CcDisplayMonitor *monitor = l->data;
+  monitor = cc_display_state_lookup_monitor (current_state, value, error);
+  if (!monitor)
+    return FALSE;
 
-      if (g_str_equal (cc_display_monitor_get_connector (monitor),
-                       connector))
-        {
-          current_monitor = monitor;
-          return add_monitor_with_preferred_mode (monitor, error);
-        }
+  current_monitor = monitor;
+
+  if (patch_mode && !pending_logical_monitor_config)
+    {
+      select_patched_monitor (monitor);
+      return TRUE;
     }
 
-  g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-               "Tried to add unknown monitor %s", value);
-  return FALSE;
+  if (patch_mode)
+    cc_display_config_remove_monitor (pending_config, monitor);
+
+  return add_monitor_with_preferred_mode (monitor, error);
+}
+
+static CcDisplayMode *
+lookup_mode (CcDisplayMonitor *monitor,
+             const char *value)
+{
+  int width, height;
+  int n_parsed = 0;
+
+  if (g_str_equal (value, "highest-refresh"))
+    return cc_display_monitor_get_highest_refresh_mode (monitor);
+  else if (g_str_equal (value, "max-resolution") ||
+           g_str_equal (value, "max"))
+    return cc_display_monitor_get_max_resolution_mode (monitor);
+  else if (g_str_equal (value, "native"))
+    return cc_display_monitor_get_native_mode (monitor);
+
+  if (sscanf (value, "%dx%d@max%n", &width, &height, &n_parsed) == 2 &&
+      n_parsed > 0 && value[n_parsed] == '\0')
+    return cc_display_monitor_get_best_mode_for_resolution (monitor,
+                                                            width, height);
+
+  return cc_display_monitor_lookup_mode (monitor, value);
 }
 
 static gboolean
@@ -435,17 +819,15 @@ handle_mode_arg (const char *optarg,
                  GError **error)
 {
   CcDisplayMode *mode;
-  GList *monitor_configs;
-  CcDisplayMonitorConfig *monitor_config;
 
-  if (!current_monitor)
+  if (!current_monitor || !current_monitor_config)
   {
     g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
                  "No current monitor");
     return FALSE;
   }
 
-  mode = cc_display_monitor_lookup_mode (current_monitor, optarg);
+  mode = lookup_mode (current_monitor, optarg);
   if (!mode)
   {
     g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
@@ -453,109 +835,451 @@ handle_mode_arg (const char *optarg,
     return FALSE;
   }
 
-  monitor_configs =
-    cc_display_logical_monitor_config_get_monitor_configs (pending_logical_monitor_config);
-  monitor_config = g_list_last (monitor_configs)->data;
-  cc_display_monitor_config_set_mode (monitor_config, mode);
+  cc_display_monitor_config_set_mode (current_monitor_config, mode);
+
+  return TRUE;
+}
+
+static gboolean
+handle_patch_arg (GError **error)
+{
+  if (pending_logical_monitor_config || current_monitor ||
+      cc_display_config_get_logical_logical_monitor_configs (pending_config))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "--patch must come before any other configuration");
+      return FALSE;
+    }
+
+  cc_display_config_free (pending_config);
+  pending_config = cc_display_config_new_from_state (current_state);
+  patch_mode = TRUE;
+
+  return TRUE;
+}
+
+static gboolean
+handle_off_arg (GError **error)
+{
+  if (!patch_mode || pending_logical_monitor_config || !current_monitor)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "--off needs a monitor selected with -M after --patch");
+      return FALSE;
+    }
+
+  cc_display_config_remove_monitor (pending_config, current_monitor);
+  current_monitor = NULL;
+  current_monitor_config = NULL;
+  patched_logical_monitor_config = NULL;
 
   return TRUE;
 }
 
+/* A logical monitor of the current state and what the patch made of it */
+typedef struct _PatchedLogicalMonitor
+{
+  cairo_rectangle_int_t old_rect;
+  cairo_rectangle_int_t new_rect;
+  /* NULL if the patch turned all its monitors off */
+  CcDisplayLogicalMonitorConfig *config;
+} PatchedLogicalMonitor;
+
+static gboolean
+ranges_overlap (int start,
+                int length,
+                int other_start,
+                int other_length)
+{
+  return start < other_start + other_length && other_start < start + length;
+}
+
+/*
+ * Moves the logical monitors of the patched configuration so that resizing
+ * or turning off one of them leaves neither a gap nor an overlap: whatever was
+ * to the right of or below it moves by as much as it grew or shrank. Logical
+ * monitors the patch added go to the right of the others.
+ */
 static void
-print_pending_configuration (void)
+pack_patched_layout (CcDisplayLayoutMode layout_mode)
 {
-  GList *logical_monitor_configs;
+  g_autoptr(CcDisplayConfig) current_config = NULL;
+  g_autoptr(GArray) patched = NULL;
+  g_autoptr(GPtrArray) added = NULL;
   GList *l;
-
-  logical_monitor_configs =
-    cc_display_config_get_logical_logical_monitor_configs (pending_config);
-  for (l = logical_monitor_configs; l; l = l->next)
+  unsigned int i, j;
+  int x = 0;
+
+  patched = g_array_new (FALSE, TRUE, sizeof (PatchedLogicalMonitor));
+  current_config = cc_display_config_new_from_state (current_state);
+  for (l = cc_display_config_get_logical_logical_monitor_configs (current_config);
+       l;
+       l = l->next)
     {
-      CcDisplayLogicalMonitorConfig *logical_monitor_config = l->data;
-      cairo_rectangle_int_t layout;
-      bool is_primary;
-      double scale;
-      GList *monitor_configs;
+      PatchedLogicalMonitor patched_logical_monitor = { 0 };
       GList *k;
 
-      cc_display_logical_monitor_config_calculate_layout (logical_monitor_config,
-                                                          &layout);
-      is_primary =
-        cc_display_logical_monitor_config_is_primary (logical_monitor_config);
-      scale =
-        cc_display_logical_monitor_config_get_scale (logical_monitor_config);
-      g_print ("Logical monitor [ %dx%d+%d+%d ]%s, scale = %g\n",
-               layout.width, layout.height, layout.x, layout.y,
-               is_primary ? ", PRIMARY" : "",
-               scale);
+      cc_display_logical_monitor_config_calculate_rect (l->data,
+                                                        cc_display_state_get_layout_mode (current_state),
+                                                        &patched_logical_monitor.old_rect);
 
-      monitor_configs =
-        cc_display_logical_monitor_config_get_monitor_configs (logical_monitor_config);
-      for (k = monitor_configs; k; k = k->next)
+      for (k = cc_display_logical_monitor_config_get_monitor_configs (l->data);
+           k && !patched_logical_monitor.config;
+           k = k->next)
         {
-          CcDisplayMonitorConfig *monitor_config = k->data;
-          CcDisplayMonitor *monitor;
-          CcDisplayMode *mode;
-          const char *connector;
-          int resolution_width, resolution_height;
-          double refresh_rate;
+          CcDisplayLogicalMonitorConfig *logical_monitor_config = NULL;
 
-          monitor = cc_display_monitor_config_get_monitor (monitor_config);
-          connector = cc_display_monitor_get_connector (monitor);
-          mode = cc_display_monitor_config_get_mode (monitor_config);
-          cc_display_mode_get_resolution (mode,
-                                          &resolution_width, &resolution_height);
-          refresh_rate = cc_display_mode_get_refresh_rate (mode);
+          cc_display_config_lookup_monitor_config (pending_config,
+                                                   cc_display_monitor_config_get_monitor (k->data),
+                                                   &logical_monitor_config);
+          patched_logical_monitor.config = logical_monitor_config;
+        }
 
-          g_print ("  Monitor [ %s ] %dx%d@%g\n",
-                   connector,
-                   resolution_width, resolution_height,
-                   refresh_rate);
+      /* Monitors moved into another logical monitor only count there */
+      for (i = 0; i < patched->len; i++)
+        {
+          if (g_array_index (patched, PatchedLogicalMonitor, i).config ==
+              patched_logical_monitor.config)
+            patched_logical_monitor.config = NULL;
+        }
+
+      if (patched_logical_monitor.config)
+        {
+          cc_display_logical_monitor_config_calculate_rect (patched_logical_monitor.config,
+                                                            layout_mode,
+                                                            &patched_logical_monitor.new_rect);
+        }
+      else
+        {
+          patched_logical_monitor.new_rect.x = patched_logical_monitor.old_rect.x;
+          patched_logical_monitor.new_rect.y = patched_logical_monitor.old_rect.y;
         }
+
+      g_array_append_val (patched, patched_logical_monitor);
     }
-}
 
-static int
-set_monitors (int argc,
-              char **argv,
-              GError **error)
-{
-  struct option options[] = {
-    { "logical-monitor", no_argument, 0, 'L' },
-    { "persistent", no_argument, 0, 'P' },
-    { "x", required_argument, 0, 'x' },
-    { "y", required_argument, 0, 'y' },
-    { "scale", required_argument, 0, 's' },
-    { "transform", required_argument, 0, 't' },
-    { "primary", no_argument, 0, 'p' },
-    { "monitor", required_argument, 0, 'M' },
-    { "mode", required_argument, 0, 'm' },
-    { "logical-layout-mode", no_argument, 0, 0 },
-    { "physical-layout-mode", no_argument, 0, 0 },
-    { "help", no_argument, 0, 'h' },
-    { }
-  };
-  CcDisplayConfigManager *config_manager;
-  CcDisplayConfigMethod method = CC_DISPLAY_METHOD_TEMPORARY;
+  for (i = 0; i < patched->len; i++)
+    {
+      PatchedLogicalMonitor *patched_logical_monitor =
+        &g_array_index (patched, PatchedLogicalMonitor, i);
+      const cairo_rectangle_int_t *rect = &patched_logical_monitor->old_rect;
+      int dx = 0, dy = 0;
+      int old_x, old_y;
 
-  config_manager = cc_display_config_manager_new (error);
-  if (!config_manager)
-    return FALSE;
+      if (!patched_logical_monitor->config)
+        continue;
 
-  current_state = cc_display_config_manager_new_current_state (config_manager,
-                                                               error);
-  if (!current_state)
-    return FALSE;
+      for (j = 0; j < patched->len; j++)
+        {
+          PatchedLogicalMonitor *other =
+            &g_array_index (patched, PatchedLogicalMonitor, j);
+          const cairo_rectangle_int_t *other_rect = &other->old_rect;
+
+          if (j == i)
+            continue;
+
+          if (other_rect->x + other_rect->width <= rect->x &&
+              ranges_overlap (other_rect->y, other_rect->height,
+                              rect->y, rect->height))
+            dx += other->new_rect.width - other_rect->width;
+
+          if (other_rect->y + other_rect->height <= rect->y &&
+              ranges_overlap (other_rect->x, other_rect->width,
+                              rect->x, rect->width))
+            dy += other->new_rect.height - other_rect->height;
+        }
 
-  pending_config = cc_display_config_new ();
+      cc_display_logical_monitor_config_get_position (patched_logical_monitor->config,
+                                                      &old_x, &old_y);
+      cc_display_logical_monitor_config_set_position (patched_logical_monitor->config,
+                                                      old_x + dx, old_y + dy);
+    }
 
-  while (true)
+  added = g_ptr_array_new ();
+  for (l = cc_display_config_get_logical_logical_monitor_configs (pending_config);
+       l;
+       l = l->next)
     {
-      int c;
-      int option_index;
+      gboolean is_added = TRUE;
+      cairo_rectangle_int_t rect;
 
-      c = getopt_long (argc, argv, "LPx:dy:ds:dt:spM:sm:dh",
-                       options, &option_index);
+      for (i = 0; i < patched->len && is_added; i++)
+        {
+          if (g_array_index (patched, PatchedLogicalMonitor, i).config == l->data)
+            is_added = FALSE;
+        }
+
+      if (is_added)
+        {
+          g_ptr_array_add (added, l->data);
+          continue;
+        }
+
+      cc_display_logical_monitor_config_calculate_rect (l->data, layout_mode,
+                                                        &rect);
+      x = MAX (x, rect.x + rect.width);
+    }
+
+  for (i = 0; i < added->len; i++)
+    {
+      CcDisplayLogicalMonitorConfig *logical_monitor_config =
+        g_ptr_array_index (added, i);
+      cairo_rectangle_int_t rect;
+
+      cc_display_logical_monitor_config_set_position (logical_monitor_config,
+                                                      x, 0);
+      cc_display_logical_monitor_config_calculate_rect (logical_monitor_config,
+                                                        layout_mode, &rect);
+      x += rect.width;
+    }
+}
+
+/* The compositor wants the layout to start at the origin */
+static void
+move_pending_config_to_origin (CcDisplayLayoutMode layout_mode)
+{
+  GList *logical_monitor_configs;
+  int min_x = G_MAXINT, min_y = G_MAXINT;
+  GList *l;
+
+  logical_monitor_configs =
+    cc_display_config_get_logical_logical_monitor_configs (pending_config);
+  for (l = logical_monitor_configs; l; l = l->next)
+    {
+      cairo_rectangle_int_t rect;
+
+      cc_display_logical_monitor_config_calculate_rect (l->data, layout_mode,
+                                                        &rect);
+      min_x = MIN (min_x, rect.x);
+      min_y = MIN (min_y, rect.y);
+    }
+
+  for (l = logical_monitor_configs; l; l = l->next)
+    {
+      int x, y;
+
+      cc_display_logical_monitor_config_get_position (l->data, &x, &y);
+      cc_display_logical_monitor_config_set_position (l->data,
+                                                      x - min_x, y - min_y);
+    }
+}
+
+/*
+ * Unless positions were given with -x or -y, the layout is packed around the
+ * changes of the patch; either way, it is moved to the origin and checked
+ * before anything is sent to the compositor.
+ */
+static gboolean
+repair_patched_layout (GError **error)
+{
+  CcDisplayLayoutMode layout_mode;
+
+  layout_mode = get_pending_layout_mode ();
+  if (!patch_positions_given)
+    pack_patched_layout (layout_mode);
+  move_pending_config_to_origin (layout_mode);
+
+  if (!cc_display_config_is_layout_valid (pending_config, layout_mode))
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                   "The patched layout has overlapping logical monitors or "
+                   "ones not touching any other; place them with -x and -y");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+finalize_patched_config (GError **error)
+{
+  GList *logical_monitor_configs;
+  GList *l;
+
+  if (pending_logical_monitor_config &&
+      !finalize_pending_logical_monitor_config ())
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Configuration incomplete");
+      return FALSE;
+    }
+
+  if (pending_layout_mode_set)
+    cc_display_config_set_layout_mode (pending_config,
+                                       pending_layout_mode);
+
+  logical_monitor_configs =
+    cc_display_config_get_logical_logical_monitor_configs (pending_config);
+  if (!logical_monitor_configs)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Can't turn off every monitor");
+      return FALSE;
+    }
+
+  if (!repair_patched_layout (error))
+    return FALSE;
+
+  for (l = logical_monitor_configs; l; l = l->next)
+    {
+      if (cc_display_logical_monitor_config_is_primary (l->data))
+        return TRUE;
+    }
+
+  cc_display_logical_monitor_config_set_is_primary (logical_monitor_configs->data,
+                                                    TRUE);
+
+  return TRUE;
+}
+
+static void
+print_configuration (CcDisplayConfig *config)
+{
+  GList *logical_monitor_configs;
+  GList *l;
+
+  logical_monitor_configs =
+    cc_display_config_get_logical_logical_monitor_configs (config);
+  for (l = logical_monitor_configs; l; l = l->next)
+    {
+      CcDisplayLogicalMonitorConfig *logical_monitor_config = l->data;
+      cairo_rectangle_int_t layout;
+      bool is_primary;
+      double scale;
+      GList *monitor_configs;
+      GList *k;
+
+      cc_display_logical_monitor_config_calculate_layout (logical_monitor_config,
+                                                          &layout);
+      is_primary =
+        cc_display_logical_monitor_config_is_primary (logical_monitor_config);
+      scale =
+        cc_display_logical_monitor_config_get_scale (logical_monitor_config);
+      g_print ("Logical monitor [ %dx%d+%d+%d ]%s, scale = %g\n",
+               layout.width, layout.height, layout.x, layout.y,
+               is_primary ? ", PRIMARY" : "",
+               scale);
+
+      monitor_configs =
+        cc_display_logical_monitor_config_get_monitor_configs (logical_monitor_config);
+      for (k = monitor_configs; k; k = k->next)
+        {
+          CcDisplayMonitorConfig *monitor_config = k->data;
+          CcDisplayMonitor *monitor;
+          CcDisplayMode *mode;
+          const char *connector;
+          int resolution_width, resolution_height;
+          double refresh_rate;
+
+          monitor = cc_display_monitor_config_get_monitor (monitor_config);
+          connector = cc_display_monitor_get_connector (monitor);
+          mode = cc_display_monitor_config_get_mode (monitor_config);
+          cc_display_mode_get_resolution (mode,
+                                          &resolution_width, &resolution_height);
+          refresh_rate = cc_display_mode_get_refresh_rate (mode);
+
+          g_print ("  Monitor [ %s ] %dx%d@%g\n",
+                   connector,
+                   resolution_width, resolution_height,
+                   refresh_rate);
+        }
+    }
+}
+
+static void
+print_transition (CcDisplayTransition *transition)
+{
+  unsigned int n_steps;
+  unsigned int i;
+
+  n_steps = cc_display_transition_get_n_steps (transition);
+  g_print ("Transition in %u step%s, %d mode change%s\n",
+           n_steps, n_steps == 1 ? "" : "s",
+           cc_display_transition_get_n_mode_changes (transition),
+           cc_display_transition_get_n_mode_changes (transition) == 1 ? "" : "s");
+
+  for (i = 0; i < n_steps; i++)
+    {
+      int n_mode_changes;
+
+      n_mode_changes =
+        cc_display_transition_get_step_n_mode_changes (transition, i);
+      if (n_mode_changes == 0)
+        g_print ("  Step %u: no modeset\n", i + 1);
+      else
+        g_print ("  Step %u: %d monitor%s changing mode\n",
+                 i + 1, n_mode_changes, n_mode_changes == 1 ? "" : "s");
+    }
+}
+
+typedef struct _SetOptions
+{
+  CcDisplayConfigMethod method;
+  gboolean dry_run;
+  gboolean sync_refresh;
+  gboolean show_help;
+  const char *preview;
+  unsigned int confirm_within;
+} SetOptions;
+
+/*
+ * A patch that changes nothing is not applied, unless it is to be persisted.
+ */
+static gboolean
+is_noop_patch (SetOptions *set_options)
+{
+  return (patch_mode &&
+          set_options->method != CC_DISPLAY_METHOD_PERSISTENT &&
+          cc_display_config_is_current (pending_config, current_state));
+}
+
+/*
+ * Builds pending_config against current_state from the 'set' arguments. May
+ * be called repeatedly, once per state.
+ */
+static gboolean
+build_pending_config_from_args (int argc,
+                                char **argv,
+                                SetOptions *set_options,
+                                GError **error)
+{
+  struct option options[] = {
+    { "logical-monitor", no_argument, 0, 'L' },
+    { "persistent", no_argument, 0, 'P' },
+    { "x", required_argument, 0, 'x' },
+    { "y", required_argument, 0, 'y' },
+    { "scale", required_argument, 0, 's' },
+    { "transform", required_argument, 0, 't' },
+    { "primary", no_argument, 0, 'p' },
+    { "monitor", required_argument, 0, 'M' },
+    { "mode", required_argument, 0, 'm' },
+    { "logical-layout-mode", no_argument, 0, 0 },
+    { "physical-layout-mode", no_argument, 0, 0 },
+    { "dry-run", no_argument, 0, 0 },
+    { "sync-refresh", no_argument, 0, 0 },
+    { "verify", no_argument, 0, 0 },
+    { "patch", no_argument, 0, 0 },
+    { "off", no_argument, 0, 0 },
+    { "preview", required_argument, 0, 0 },
+    { "confirm-within", required_argument, 0, 0 },
+    { "help", no_argument, 0, 'h' },
+    { }
+  };
+
+  *set_options = (SetOptions) {
+    .method = CC_DISPLAY_METHOD_TEMPORARY,
+  };
+
+  pending_config = cc_display_config_new ();
+  optind = 0;
+
+  while (true)
+    {
+      int c;
+      int option_index;
+
+      c = getopt_long (argc, argv, "LPx:dy:ds:dt:spM:sm:dh",
+                       options, &option_index);
 
       if (c < 0)
         break;
@@ -575,6 +1299,46 @@ set_monitors (int argc,
               pending_layout_mode = CC_DISPLAY_LAYOUT_MODE_PHYSICAL;
               pending_layout_mode_set = TRUE;
             }
+          else if (g_str_equal (options[option_index].name, "dry-run"))
+            {
+              set_options->dry_run = TRUE;
+            }
+          else if (g_str_equal (options[option_index].name, "sync-refresh"))
+            {
+              set_options->sync_refresh = TRUE;
+            }
+          else if (g_str_equal (options[option_index].name, "verify"))
+            {
+              set_options->method = CC_DISPLAY_METHOD_VERIFY;
+            }
+          else if (g_str_equal (options[option_index].name, "patch"))
+            {
+              if (!handle_patch_arg (error))
+                return FALSE;
+            }
+          else if (g_str_equal (options[option_index].name, "off"))
+            {
+              if (!handle_off_arg (error))
+                return FALSE;
+            }
+          else if (g_str_equal (options[option_index].name, "preview"))
+            {
+              set_options->preview = optarg;
+            }
+          else if (g_str_equal (options[option_index].name, "confirm-within"))
+            {
+              guint64 seconds;
+
+              if (!g_ascii_string_to_unsigned (optarg, 10, 1, G_MAXUINT,
+                                               &seconds, NULL))
+                {
+                  g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                               "Invalid timeout %s", optarg);
+                  return FALSE;
+                }
+
+              set_options->confirm_within = seconds;
+            }
           else
             {
               g_assert_not_reached ();
@@ -587,60 +1351,1632 @@ set_monitors (int argc,
           break;
 
         case 'P':
-          method = CC_DISPLAY_METHOD_PERSISTENT;
+          set_options->method = CC_DISPLAY_METHOD_PERSISTENT;
+          break;
+
+        case 'x':
+        case 'y':
+        case 's':
+        case 't':
+          if (!handle_logical_monitor_property_arg (c, optarg, error))
+            return FALSE;
+          break;
+
+        case 'p':
+          if (!handle_logical_monitor_primary_arg (error))
+            return FALSE;
+          break;
+
+        case 'M':
+          if (!handle_monitor_arg (optarg, error))
+            return FALSE;
+          break;
+
+	case 'm':
+	  if (!handle_mode_arg (optarg, error))
+            return FALSE;
           break;
 
-        case 'x':
-        case 'y':
-        case 's':
-        case 't':
-          if (!handle_logical_monitor_property_arg (c, optarg, error))
-            return FALSE;
-          break;
+        case 'h':
+          set_options->show_help = TRUE;
+          return TRUE;
+        }
+    }
+
+  if (patch_mode)
+    {
+      if (!finalize_patched_config (error))
+        return FALSE;
+    }
+  else if (!finalize_pending_logical_monitor_config ())
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Configuration incomplete");
+      return FALSE;
+    }
+
+  if (set_options->sync_refresh)
+    {
+      double deviation;
+
+      deviation = cc_display_config_sync_refresh_rates (pending_config);
+      g_print ("Synchronized refresh rates, max deviation %g Hz\n", deviation);
+    }
+
+  return TRUE;
+}
+
+#define VERIFY_CACHE_GROUP "Fingerprints"
+
+/* Beyond this many entries, the oldest ones are evicted */
+#define VERIFY_CACHE_MAX_ENTRIES 256
+
+typedef enum _VerifyResult
+{
+  VERIFY_RESULT_UNKNOWN,
+  VERIFY_RESULT_VALID,
+  VERIFY_RESULT_REJECTED,
+} VerifyResult;
+
+static char *
+get_verify_cache_path (void)
+{
+  return g_build_filename (g_get_user_cache_dir (),
+                           "gnome-monitor-config",
+                           "verified-configs.ini",
+                           NULL);
+}
+
+/* A missing or unreadable cache is the same as an empty one */
+static GKeyFile *
+load_verify_cache (void)
+{
+  g_autoptr(GKeyFile) key_file = NULL;
+  g_autofree char *path = NULL;
+
+  key_file = g_key_file_new ();
+  path = get_verify_cache_path ();
+  g_key_file_load_from_file (key_file, path, G_KEY_FILE_NONE, NULL);
+
+  return g_steal_pointer (&key_file);
+}
+
+static VerifyResult
+lookup_verify_result (GKeyFile *key_file,
+                      const char *fingerprint)
+{
+  g_autofree char *value = NULL;
+
+  value = g_key_file_get_string (key_file, VERIFY_CACHE_GROUP, fingerprint,
+                                 NULL);
+  if (g_strcmp0 (value, "valid") == 0)
+    return VERIFY_RESULT_VALID;
+  else if (g_strcmp0 (value, "rejected") == 0)
+    return VERIFY_RESULT_REJECTED;
+  else
+    return VERIFY_RESULT_UNKNOWN;
+}
+
+/*
+ * New entries are appended to the group, so the keys are ordered oldest
+ * first and the excess is dropped from the front.
+ */
+static void
+store_verify_result (GKeyFile *key_file,
+                     const char *fingerprint,
+                     VerifyResult result)
+{
+  g_autofree char *path = NULL;
+  g_autofree char *dir = NULL;
+  g_auto(GStrv) keys = NULL;
+  g_autoptr(GError) error = NULL;
+  gsize n_keys = 0;
+  gsize i;
+
+  g_key_file_remove_key (key_file, VERIFY_CACHE_GROUP, fingerprint, NULL);
+  g_key_file_set_string (key_file, VERIFY_CACHE_GROUP, fingerprint,
+                         result == VERIFY_RESULT_VALID ? "valid"
+                                                       : "rejected");
+
+  keys = g_key_file_get_keys (key_file, VERIFY_CACHE_GROUP, &n_keys, NULL);
+  for (i = 0; n_keys - i > VERIFY_CACHE_MAX_ENTRIES; i++)
+    g_key_file_remove_key (key_file, VERIFY_CACHE_GROUP, keys[i], NULL);
+
+  path = get_verify_cache_path ();
+
+  dir = g_path_get_dirname (path);
+  if (g_mkdir_with_parents (dir, 0700) != 0 ||
+      !g_key_file_save_to_file (key_file, path, &error))
+    g_printerr ("Failed to update verification cache %s: %s\n",
+                path, error ? error->message : g_strerror (errno));
+}
+
+/*
+ * Asks the compositor whether it would accept pending_config, unless the
+ * answer is already known from an earlier run. Only outright rejections are
+ * remembered, not failures such as a stale serial.
+ */
+static gboolean
+verify_pending_config (CcDisplayConfigManager *config_manager,
+                       CcDisplayTransition *transition,
+                       GError **error)
+{
+  g_autoptr(GKeyFile) verify_cache = NULL;
+  g_autofree char *fingerprint = NULL;
+  g_autoptr(GError) local_error = NULL;
+
+  verify_cache = load_verify_cache ();
+  fingerprint = cc_display_config_get_fingerprint (pending_config,
+                                                   current_state);
+  switch (lookup_verify_result (verify_cache, fingerprint))
+    {
+    case VERIFY_RESULT_VALID:
+      g_print ("Configuration is valid (cached)\n");
+      return TRUE;
+    case VERIFY_RESULT_REJECTED:
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                   "Configuration was rejected (cached)");
+      return FALSE;
+    case VERIFY_RESULT_UNKNOWN:
+      break;
+    }
+
+  if (!config_manager)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                   "Configuration %s is not in the verification cache",
+                   fingerprint);
+      return FALSE;
+    }
+
+  if (!cc_display_config_manager_apply_transition (config_manager,
+                                                   current_state,
+                                                   transition,
+                                                   CC_DISPLAY_METHOD_VERIFY,
+                                                   &local_error))
+    {
+      if (g_error_matches (local_error,
+                           G_DBUS_ERROR, G_DBUS_ERROR_INVALID_ARGS))
+        store_verify_result (verify_cache, fingerprint,
+                             VERIFY_RESULT_REJECTED);
+
+      g_propagate_error (error, g_steal_pointer (&local_error));
+      return FALSE;
+    }
+
+  store_verify_result (verify_cache, fingerprint, VERIFY_RESULT_VALID);
+  g_print ("Configuration is valid\n");
+
+  return TRUE;
+}
+
+static char *
+get_confirm_pid_path (void)
+{
+  return g_build_filename (g_get_user_runtime_dir (),
+                           "gnome-monitor-config",
+                           "confirm.pid",
+                           NULL);
+}
+
+typedef struct _Confirmation
+{
+  GMainLoop *loop;
+  gboolean confirmed;
+} Confirmation;
+
+static gboolean
+on_confirmed (gpointer user_data)
+{
+  Confirmation *confirmation = user_data;
+
+  confirmation->confirmed = TRUE;
+  g_main_loop_quit (confirmation->loop);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+on_not_confirmed (gpointer user_data)
+{
+  Confirmation *confirmation = user_data;
+
+  g_main_loop_quit (confirmation->loop);
+
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+on_stdin_ready (int fd,
+                GIOCondition condition,
+                gpointer user_data)
+{
+  char buffer[256];
+  ssize_t n_read;
+
+  n_read = read (fd, buffer, sizeof (buffer));
+  if (n_read <= 0)
+    return G_SOURCE_REMOVE;
+
+  return on_confirmed (user_data);
+}
+
+/*
+ * Waits until Enter is pressed or 'confirm' sends SIGUSR1, for at most
+ * @timeout_s seconds. Interrupting counts as not confirming.
+ */
+static gboolean
+wait_for_confirmation (unsigned int timeout_s)
+{
+  g_autoptr(GMainLoop) loop = NULL;
+  g_autoptr(GPtrArray) sources = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree char *pid_path = NULL;
+  g_autofree char *pid_dir = NULL;
+  g_autofree char *pid_string = NULL;
+  g_autofree char *written_pid_string = NULL;
+  Confirmation confirmation;
+  unsigned int i;
+
+  loop = g_main_loop_new (NULL, FALSE);
+  confirmation = (Confirmation) { .loop = loop };
+
+  sources = g_ptr_array_new_with_free_func ((GDestroyNotify) g_source_unref);
+  g_ptr_array_add (sources, g_timeout_source_new_seconds (timeout_s));
+  g_source_set_callback (sources->pdata[0], on_not_confirmed,
+                         &confirmation, NULL);
+  g_ptr_array_add (sources, g_unix_signal_source_new (SIGINT));
+  g_source_set_callback (sources->pdata[1], on_not_confirmed,
+                         &confirmation, NULL);
+  g_ptr_array_add (sources, g_unix_signal_source_new (SIGTERM));
+  g_source_set_callback (sources->pdata[2], on_not_confirmed,
+                         &confirmation, NULL);
+  g_ptr_array_add (sources, g_unix_signal_source_new (SIGUSR1));
+  g_source_set_callback (sources->pdata[3], on_confirmed,
+                         &confirmation, NULL);
+  if (isatty (STDIN_FILENO))
+    {
+      g_ptr_array_add (sources, g_unix_fd_source_new (STDIN_FILENO, G_IO_IN));
+      g_source_set_callback (sources->pdata[4], G_SOURCE_FUNC (on_stdin_ready),
+                             &confirmation, NULL);
+    }
+
+  for (i = 0; i < sources->len; i++)
+    g_source_attach (sources->pdata[i], NULL);
+
+  /* Only advertised once SIGUSR1 no longer terminates the process */
+  pid_path = get_confirm_pid_path ();
+  pid_dir = g_path_get_dirname (pid_path);
+  pid_string = g_strdup_printf ("%d\n", (int) getpid ());
+  if (g_mkdir_with_parents (pid_dir, 0700) != 0 ||
+      !g_file_set_contents (pid_path, pid_string, -1, &error))
+    g_printerr ("Failed to write %s, only Enter confirms: %s\n",
+                pid_path, error ? error->message : g_strerror (errno));
+
+  g_main_loop_run (loop);
+
+  for (i = 0; i < sources->len; i++)
+    g_source_destroy (sources->pdata[i]);
+
+  if (g_file_get_contents (pid_path, &written_pid_string, NULL, NULL) &&
+      g_str_equal (written_pid_string, pid_string))
+    g_unlink (pid_path);
+
+  return confirmation.confirmed;
+}
+
+/*
+ * Applies the transition temporarily and reverts to the configuration of
+ * current_state unless confirmed in time. The previous configuration is
+ * serialized before anything is applied, so reverting is one method call.
+ */
+static gboolean
+apply_with_confirmation (CcDisplayConfigManager *config_manager,
+                         CcDisplayTransition *transition,
+                         unsigned int timeout_s,
+                         GError **error)
+{
+  g_autoptr(CcDisplayConfigSnapshot) snapshot = NULL;
+  unsigned int n_applied_steps;
+
+  snapshot = cc_display_config_snapshot_new (current_state);
+
+  if (!cc_display_config_manager_apply_transition_full (config_manager,
+                                                        current_state,
+                                                        transition,
+                                                        CC_DISPLAY_METHOD_TEMPORARY,
+                                                        &n_applied_steps,
+                                                        error))
+    {
+      g_autoptr(GError) restore_error = NULL;
+
+      /* A failed step may leave monitors disabled, so don't leave it at that */
+      if (n_applied_steps == 0)
+        return FALSE;
+
+      if (!cc_display_config_manager_restore_snapshot (config_manager,
+                                                       snapshot,
+                                                       &restore_error))
+        {
+          g_prefix_error (error,
+                          "Failed to revert to the previous configuration "
+                          "(%s) after: ", restore_error->message);
+          return FALSE;
+        }
+
+      g_prefix_error (error, "Reverted to the previous configuration after: ");
+      return FALSE;
+    }
+
+  g_print ("Press Enter or run '%s confirm' within %u seconds to keep this "
+           "configuration\n", g_get_prgname (), timeout_s);
+
+  if (wait_for_confirmation (timeout_s))
+    {
+      g_print ("Configuration kept\n");
+      return TRUE;
+    }
+
+  if (!cc_display_config_manager_restore_snapshot (config_manager, snapshot,
+                                                   error))
+    return FALSE;
+
+  g_set_error (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+               "Not confirmed, reverted to the previous configuration");
+  return FALSE;
+}
+
+static gboolean
+confirm_config (GError **error)
+{
+  g_autofree char *pid_path = NULL;
+  g_autofree char *pid_string = NULL;
+  gint64 pid = 0;
+
+  pid_path = get_confirm_pid_path ();
+  if (g_file_get_contents (pid_path, &pid_string, NULL, NULL))
+    pid = g_ascii_strtoll (pid_string, NULL, 10);
+
+  if (pid <= 0 || kill ((pid_t) pid, SIGUSR1) != 0)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                   "No configuration is waiting for confirmation");
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+clear_pending_config (void)
+{
+  g_clear_pointer (&pending_logical_monitor_config,
+                   cc_display_logical_monitor_config_free);
+  g_clear_pointer (&pending_config, cc_display_config_free);
+  pending_layout_mode_set = FALSE;
+  current_monitor = NULL;
+  current_monitor_config = NULL;
+  patch_mode = FALSE;
+  patch_positions_given = FALSE;
+  patched_logical_monitor_config = NULL;
+}
+
+#define PREVIEW_ASCII_COLUMNS 72
+
+/*
+ * Renders pending_config to a PNG file, or to the terminal if @target is
+ * "ascii". Only the current state is needed for this.
+ */
+static gboolean
+preview_pending_config (const char *target,
+                        GError **error)
+{
+  if (g_str_equal (target, "ascii"))
+    {
+      g_autofree char *diagram = NULL;
+
+      diagram = cc_display_preview_render_ascii (pending_config,
+                                                 get_pending_layout_mode (),
+                                                 PREVIEW_ASCII_COLUMNS);
+      g_print ("%s", diagram);
+      return TRUE;
+    }
+
+  if (!cc_display_preview_render_png (pending_config,
+                                      get_pending_layout_mode (),
+                                      target,
+                                      error))
+    return FALSE;
+
+  g_print ("Preview written to %s\n", target);
+  return TRUE;
+}
+
+static gboolean
+set_monitors_from_args (CcDisplayConfigManager *config_manager,
+                        int argc,
+                        char **argv,
+                        GError **error)
+{
+  SetOptions set_options;
+  g_autoptr(CcDisplayTransition) transition = NULL;
+
+  if (!build_pending_config_from_args (argc, argv, &set_options, error))
+    return FALSE;
+
+  if (set_options.show_help)
+    {
+      print_help ();
+      return TRUE;
+    }
+
+  print_configuration (pending_config);
+
+  if (set_options.preview)
+    return preview_pending_config (set_options.preview, error);
+
+  if (is_noop_patch (&set_options))
+    {
+      g_print ("Configuration unchanged, nothing to apply\n");
+      return TRUE;
+    }
+
+  transition = cc_display_transition_new (current_state, pending_config, error);
+  if (!transition)
+    return FALSE;
+
+  if (set_options.dry_run ||
+      cc_display_transition_get_n_steps (transition) > 1)
+    print_transition (transition);
+
+  if (set_options.dry_run)
+    return TRUE;
+
+  if (set_options.method == CC_DISPLAY_METHOD_VERIFY)
+    return verify_pending_config (config_manager, transition, error);
+
+  if (!config_manager)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                   "A state read with --state-from can only be used with --dry-run "
+                   "or --verify");
+      return FALSE;
+    }
+
+  if (set_options.confirm_within > 0)
+    {
+      if (set_options.method == CC_DISPLAY_METHOD_PERSISTENT)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                       "--confirm-within can't be combined with --persistent");
+          return FALSE;
+        }
+
+      return apply_with_confirmation (config_manager, transition,
+                                      set_options.confirm_within, error);
+    }
+
+  return cc_display_config_manager_apply_transition (config_manager,
+                                                     current_state,
+                                                     transition,
+                                                     set_options.method,
+                                                     error);
+}
+
+typedef struct _Seat
+{
+  const char *address;
+  CcDisplayConfigManager *config_manager;
+  CcDisplayState *state;
+  CcDisplayConfig *config;
+  CcDisplayTransition *transition;
+  CcDisplayConfigMethod method;
+  GError *error;
+} Seat;
+
+static void
+clear_seat (Seat *seat)
+{
+  g_clear_pointer (&seat->transition, cc_display_transition_free);
+  g_clear_pointer (&seat->config, cc_display_config_free);
+  g_clear_pointer (&seat->state, cc_display_state_unref);
+  g_clear_object (&seat->config_manager);
+  g_clear_error (&seat->error);
+}
+
+static void
+fetch_seat_state (gpointer data,
+                  gpointer user_data)
+{
+  Seat *seat = data;
+
+  seat->config_manager =
+    cc_display_config_manager_new_for_address (seat->address,
+                                               CC_DISPLAY_CONFIG_MANAGER_FLAGS_ONE_SHOT,
+                                               &seat->error);
+  if (!seat->config_manager)
+    return;
+
+  seat->state =
+    cc_display_config_manager_new_current_state (seat->config_manager,
+                                                 &seat->error);
+}
+
+static void
+apply_seat_config (gpointer data,
+                   gpointer user_data)
+{
+  Seat *seat = data;
+
+  if (!seat->transition)
+    return;
+
+  cc_display_config_manager_apply_transition (seat->config_manager,
+                                              seat->state,
+                                              seat->transition,
+                                              seat->method,
+                                              &seat->error);
+}
+
+static gboolean
+run_on_seats (GArray *seats,
+              GFunc func,
+              GError **error)
+{
+  GThreadPool *pool;
+  unsigned int i;
+
+  pool = g_thread_pool_new (func, NULL,
+                            MIN (seats->len, g_get_num_processors () * 2),
+                            FALSE, error);
+  if (!pool)
+    return FALSE;
+
+  for (i = 0; i < seats->len; i++)
+    {
+      Seat *seat = &g_array_index (seats, Seat, i);
+
+      if (seat->error)
+        continue;
+
+      g_thread_pool_push (pool, seat, NULL);
+    }
+
+  /* Waits for all pushed seats to be handled. */
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  return TRUE;
+}
+
+/*
+ * Applies the configuration given on the command line to the compositor of
+ * every bus in bus_addresses. Fetching the states and applying the
+ * configurations happen concurrently; the configurations are built from the
+ * arguments one seat at a time as that uses the global pending state.
+ */
+static gboolean
+set_monitors_on_buses (int argc,
+                       char **argv,
+                       GError **error)
+{
+  g_autoptr(GArray) seats = NULL;
+  unsigned int n_failed = 0;
+  gboolean dry_run = FALSE;
+  unsigned int i;
+
+  seats = g_array_sized_new (FALSE, TRUE, sizeof (Seat), bus_addresses->len);
+  g_array_set_clear_func (seats, (GDestroyNotify) clear_seat);
+  for (i = 0; i < bus_addresses->len; i++)
+    {
+      Seat seat = { .address = g_ptr_array_index (bus_addresses, i) };
+
+      g_array_append_val (seats, seat);
+    }
+
+  if (!run_on_seats (seats, fetch_seat_state, error))
+    return FALSE;
+
+  for (i = 0; i < seats->len; i++)
+    {
+      Seat *seat = &g_array_index (seats, Seat, i);
+      SetOptions set_options;
+
+      if (seat->error)
+        continue;
+
+      g_print ("Seat on %s:\n", seat->address);
+
+      current_state = seat->state;
+      if (build_pending_config_from_args (argc, argv, &set_options,
+                                          &seat->error) &&
+          !set_options.show_help)
+        {
+          if (set_options.preview || set_options.confirm_within > 0)
+            {
+              g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                           "--preview and --confirm-within can't be combined "
+                           "with --bus or --all-sessions");
+              current_state = NULL;
+              clear_pending_config ();
+              return FALSE;
+            }
+
+          print_configuration (pending_config);
+
+          if (is_noop_patch (&set_options))
+            {
+              g_print ("Configuration unchanged, nothing to apply\n");
+            }
+          else
+            {
+              seat->config = g_steal_pointer (&pending_config);
+              seat->method = set_options.method;
+              seat->transition = cc_display_transition_new (seat->state,
+                                                            seat->config,
+                                                            &seat->error);
+              if (seat->transition &&
+                  (set_options.dry_run ||
+                   cc_display_transition_get_n_steps (seat->transition) > 1))
+                print_transition (seat->transition);
+            }
+
+          dry_run = set_options.dry_run;
+        }
+      current_state = NULL;
+      clear_pending_config ();
+
+      if (set_options.show_help)
+        {
+          print_help ();
+          return TRUE;
+        }
+    }
+
+  if (!dry_run && !run_on_seats (seats, apply_seat_config, error))
+    return FALSE;
+
+  for (i = 0; i < seats->len; i++)
+    {
+      Seat *seat = &g_array_index (seats, Seat, i);
+
+      if (seat->error)
+        {
+          g_printerr ("%s: %s\n", seat->address, seat->error->message);
+          n_failed++;
+        }
+      else if (!dry_run && !seat->transition)
+        {
+          g_print ("%s: unchanged\n", seat->address);
+        }
+      else if (!dry_run)
+        {
+          g_print ("%s: applied\n", seat->address);
+        }
+    }
+
+  if (n_failed > 0)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Failed on %u of %u seats", n_failed, seats->len);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static int
+set_monitors (int argc,
+              char **argv,
+              GError **error)
+{
+  g_autoptr(CcDisplayConfigManager) config_manager = NULL;
+  gboolean ret;
+
+  if (bus_addresses)
+    return set_monitors_on_buses (argc, argv, error);
+
+  current_state = fetch_current_state (&config_manager, error);
+  if (!current_state)
+    return FALSE;
+
+  ret = set_monitors_from_args (config_manager, argc, argv, error);
+
+  clear_pending_config ();
+  g_clear_pointer (&current_state, cc_display_state_unref);
+
+  return ret;
+}
+
+static gboolean
+set_power_save_mode (int argc,
+                     char **argv,
+                     GError **error)
+{
+  g_autoptr(CcDisplayConfigManager) config_manager = NULL;
+  CcDisplayPowerSaveMode mode;
+  int64_t latency_us;
+
+  if (argc != 2)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Expected one of on, standby, suspend, off or --status");
+      return FALSE;
+    }
+
+  config_manager = cc_display_config_manager_new (error);
+  if (!config_manager)
+    return FALSE;
+
+  /* The property value is cached by the proxy; no method call needed. */
+  if (g_str_equal (argv[1], "--status"))
+    {
+      mode = cc_display_config_manager_get_power_save_mode (config_manager);
+      g_print ("Power save mode: %s\n", power_save_mode_to_str (mode));
+      return TRUE;
+    }
+
+  if (g_str_equal (argv[1], "on"))
+    {
+      mode = CC_DISPLAY_POWER_SAVE_MODE_ON;
+    }
+  else if (g_str_equal (argv[1], "standby"))
+    {
+      mode = CC_DISPLAY_POWER_SAVE_MODE_STANDBY;
+    }
+  else if (g_str_equal (argv[1], "suspend"))
+    {
+      mode = CC_DISPLAY_POWER_SAVE_MODE_SUSPEND;
+    }
+  else if (g_str_equal (argv[1], "off"))
+    {
+      mode = CC_DISPLAY_POWER_SAVE_MODE_OFF;
+    }
+  else
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Invalid power save mode '%s'", argv[1]);
+      return FALSE;
+    }
+
+  if (!cc_display_config_manager_set_power_save_mode (config_manager,
+                                                      mode,
+                                                      &latency_us,
+                                                      error))
+    return FALSE;
+
+  g_print ("Power save mode: %s (confirmed after %.3f ms)\n",
+           power_save_mode_to_str (mode),
+           latency_us / 1000.0);
+
+  return TRUE;
+}
+
+static CcDisplayStoredConfigs *
+load_stored_configs (const char *path,
+                     GError **error)
+{
+  g_autofree char *default_path = NULL;
+
+  if (!path)
+    path = default_path = cc_display_stored_configs_get_default_path ();
+
+  return cc_display_stored_configs_new_from_file (path, error);
+}
+
+static gboolean
+list_stored_configs (int argc,
+                     char **argv,
+                     GError **error)
+{
+  g_autoptr(CcDisplayConfigManager) config_manager = NULL;
+  g_autoptr(CcDisplayStoredConfigs) stored_configs = NULL;
+  g_autoptr(CcDisplayState) state = NULL;
+  CcDisplayStoredConfig *connected_stored_config;
+  unsigned int n_configs;
+  unsigned int i;
+
+  if (argc > 2)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                   "Too many arguments");
+      return FALSE;
+    }
+
+  stored_configs = load_stored_configs (argc > 1 ? argv[1] : NULL, error);
+  if (!stored_configs)
+    return FALSE;
+
+  state = fetch_current_state (&config_manager, error);
+  if (!state)
+    return FALSE;
+
+  connected_stored_config = cc_display_stored_configs_lookup (stored_configs,
+                                                              state);
+
+  n_configs = cc_display_stored_configs_get_n_configs (stored_configs);
+  for (i = 0; i < n_configs; i++)
+    {
+      CcDisplayStoredConfig *stored_config;
+      g_autoptr(GString) monitors = NULL;
+      GPtrArray *connectors;
+      unsigned int n_logical_monitors;
+      unsigned int j;
+
+      stored_config = cc_display_stored_configs_get_config (stored_configs, i);
+
+      monitors = g_string_new (NULL);
+      connectors = cc_display_stored_config_get_connectors (stored_config);
+      for (j = 0; j < connectors->len; j++)
+        {
+          if (j > 0)
+            g_string_append (monitors, ", ");
+          g_string_append (monitors, g_ptr_array_index (connectors, j));
+        }
+
+      n_logical_monitors =
+        cc_display_stored_config_get_n_logical_monitors (stored_config);
+      g_print ("Configuration %u: %s, %u logical monitor%s%s\n",
+               i + 1, monitors->str,
+               n_logical_monitors, n_logical_monitors == 1 ? "" : "s",
+               stored_config == connected_stored_config ? " [CONNECTED]" : "");
+    }
+
+  if (connected_stored_config)
+    {
+      g_autoptr(CcDisplayConfig) config = NULL;
+
+      config = cc_display_stored_config_create_config (connected_stored_config,
+                                                       state, error);
+      if (!config)
+        return FALSE;
+
+      g_print ("Stored configuration for the connected monitors:\n");
+      print_configuration (config);
+    }
+
+  return TRUE;
+}
+
+static gboolean
+apply_stored_config (int argc,
+                     char **argv,
+                     GError **error)
+{
+  struct option options[] = {
+    { "dry-run", no_argument, 0, 'd' },
+    { "persistent", no_argument, 0, 'P' },
+    { }
+  };
+  g_autoptr(CcDisplayConfigManager) config_manager = NULL;
+  g_autoptr(CcDisplayStoredConfigs) stored_configs = NULL;
+  g_autoptr(CcDisplayState) state = NULL;
+  g_autoptr(CcDisplayConfig) config = NULL;
+  g_autoptr(CcDisplayTransition) transition = NULL;
+  CcDisplayStoredConfig *stored_config;
+  CcDisplayConfigMethod method = CC_DISPLAY_METHOD_TEMPORARY;
+  gboolean dry_run = FALSE;
+
+  while (true)
+    {
+      int c;
+
+      c = getopt_long (argc, argv, "", options, NULL);
+      if (c < 0)
+        break;
+
+      switch (c)
+        {
+        case 'd':
+          dry_run = TRUE;
+          break;
+
+        case 'P':
+          method = CC_DISPLAY_METHOD_PERSISTENT;
+          break;
+
+        default:
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                       "Invalid option");
+          return FALSE;
+        }
+    }
+
+  if (argc - optind > 1)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                   "Too many arguments");
+      return FALSE;
+    }
+
+  stored_configs = load_stored_configs (optind < argc ? argv[optind] : NULL,
+                                        error);
+  if (!stored_configs)
+    return FALSE;
+
+  state = fetch_current_state (&config_manager, error);
+  if (!state)
+    return FALSE;
+
+  stored_config = cc_display_stored_configs_lookup (stored_configs, state);
+  if (!stored_config)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                   "No configuration stored for the connected monitors");
+      return FALSE;
+    }
+
+  config = cc_display_stored_config_create_config (stored_config, state,
+                                                   error);
+  if (!config)
+    return FALSE;
+
+  print_configuration (config);
+
+  /* Like 'set', pass through intermediate layouts within the max screen size */
+  transition = cc_display_transition_new (state, config, error);
+  if (!transition)
+    return FALSE;
+
+  if (dry_run || cc_display_transition_get_n_steps (transition) > 1)
+    print_transition (transition);
+
+  if (dry_run)
+    return TRUE;
+
+  if (!config_manager)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                   "A state read with --state-from can only be used with --dry-run");
+      return FALSE;
+    }
+
+  return cc_display_config_manager_apply_transition (config_manager, state,
+                                                     transition, method,
+                                                     error);
+}
+
+/*
+ * Renders the layout of each line of 'set' options in a file, against a state
+ * fetched only once. Lines that fail are reported and skipped.
+ */
+static gboolean
+preview_batch (int argc,
+               char **argv,
+               GError **error)
+{
+  struct option options[] = {
+    { "format", required_argument, 0, 'f' },
+    { "output-dir", required_argument, 0, 'o' },
+    { }
+  };
+  g_autoptr(CcDisplayConfigManager) config_manager = NULL;
+  g_autofree char *contents = NULL;
+  g_auto(GStrv) lines = NULL;
+  const char *output_dir = ".";
+  gboolean ascii = FALSE;
+  unsigned int n_layouts = 0;
+  unsigned int n_failed = 0;
+  unsigned int i;
+
+  while (true)
+    {
+      int c;
+
+      c = getopt_long (argc, argv, "", options, NULL);
+      if (c < 0)
+        break;
+
+      switch (c)
+        {
+        case 'f':
+          if (g_str_equal (optarg, "ascii"))
+            {
+              ascii = TRUE;
+            }
+          else if (g_str_equal (optarg, "png"))
+            {
+              ascii = FALSE;
+            }
+          else
+            {
+              g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                           "Invalid format '%s'", optarg);
+              return FALSE;
+            }
+          break;
+
+        case 'o':
+          output_dir = optarg;
+          break;
+
+        default:
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                       "Invalid option");
+          return FALSE;
+        }
+    }
+
+  if (argc - optind != 1)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                   "Expected a file with one layout per line");
+      return FALSE;
+    }
+
+  if (!g_file_get_contents (argv[optind], &contents, NULL, error))
+    return FALSE;
+
+  if (!ascii && g_mkdir_with_parents (output_dir, 0755) != 0)
+    {
+      int errsv = errno;
+
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errsv),
+                   "Failed to create %s: %s", output_dir, g_strerror (errsv));
+      return FALSE;
+    }
+
+  current_state = fetch_current_state (&config_manager, error);
+  if (!current_state)
+    return FALSE;
+
+  lines = g_strsplit (contents, "\n", -1);
+  for (i = 0; lines[i]; i++)
+    {
+      g_autofree char *command = NULL;
+      g_autofree char *path = NULL;
+      g_auto(GStrv) line_argv = NULL;
+      g_autoptr(GError) local_error = NULL;
+      SetOptions set_options;
+      const char *line;
+      int line_argc;
+
+      line = g_strstrip (lines[i]);
+      if (line[0] == '\0' || line[0] == '#')
+        continue;
+
+      n_layouts++;
+      g_print ("Layout %u (line %u): %s\n", n_layouts, i + 1, line);
+
+      if (!ascii)
+        {
+          g_autofree char *filename = NULL;
+
+          filename = g_strdup_printf ("layout-%03u.png", n_layouts);
+          path = g_build_filename (output_dir, filename, NULL);
+        }
+
+      command = g_strconcat ("set ", line, NULL);
+      if (!g_shell_parse_argv (command, &line_argc, &line_argv,
+                               &local_error) ||
+          !build_pending_config_from_args (line_argc, line_argv,
+                                           &set_options, &local_error) ||
+          !preview_pending_config (ascii ? "ascii" : path, &local_error))
+        {
+          g_printerr ("Line %u: %s\n", i + 1, local_error->message);
+          n_failed++;
+        }
+
+      clear_pending_config ();
+    }
+
+  g_clear_pointer (&current_state, cc_display_state_unref);
+
+  if (n_failed > 0)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Failed to render %u of %u layouts", n_failed, n_layouts);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static void
+on_state_changed (CcDisplayConfigManager *config_manager,
+                  CcDisplayState *state,
+                  gpointer user_data)
+{
+  CcDisplayMonitorsChangedStats stats;
+
+  cc_display_config_manager_get_monitors_changed_stats (config_manager,
+                                                        &stats);
+  g_print ("Serial %u: %u monitors, %u logical monitors "
+           "(%u signals, %u suppressed, %u stale, %u duplicate)\n",
+           cc_display_state_get_serial (state),
+           g_list_length (cc_display_state_get_monitors (state)),
+           g_list_length (cc_display_state_get_logical_monitors (state)),
+           stats.n_signals, stats.n_suppressed,
+           stats.n_stale_states, stats.n_duplicates);
+}
+
+static gboolean
+on_watch_interrupted (gpointer user_data)
+{
+  GMainLoop *loop = user_data;
+
+  g_main_loop_quit (loop);
+
+  return G_SOURCE_REMOVE;
+}
+
+static gboolean
+watch_monitors (int argc,
+                char **argv,
+                GError **error)
+{
+  struct option options[] = {
+    { "quiet-period", required_argument, 0, 'q' },
+    { "max-delay", required_argument, 0, 'D' },
+    { }
+  };
+  g_autoptr(CcDisplayConfigManager) config_manager = NULL;
+  g_autoptr(GMainLoop) loop = NULL;
+  guint64 quiet_period_ms = 250;
+  guint64 max_delay_ms = 2000;
+
+  while (true)
+    {
+      int c;
+      guint64 value;
+
+      c = getopt_long (argc, argv, "", options, NULL);
+      if (c < 0)
+        break;
+
+      if ((c != 'q' && c != 'D') ||
+          !g_ascii_string_to_unsigned (optarg, 10, 0, G_MAXUINT,
+                                       &value, NULL))
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                       "Invalid option");
+          return FALSE;
+        }
+
+      if (c == 'q')
+        quiet_period_ms = value;
+      else
+        max_delay_ms = value;
+    }
+
+  config_manager = cc_display_config_manager_new (error);
+  if (!config_manager)
+    return FALSE;
+
+  cc_display_config_manager_set_monitors_changed_delays (config_manager,
+                                                         quiet_period_ms,
+                                                         max_delay_ms);
+  g_signal_connect (config_manager, "state-changed",
+                    G_CALLBACK (on_state_changed), NULL);
+
+  g_print ("Waiting for monitor changes, press Ctrl+C to stop\n");
+
+  loop = g_main_loop_new (NULL, FALSE);
+  g_unix_signal_add (SIGINT, on_watch_interrupted, loop);
+  g_main_loop_run (loop);
+
+  return TRUE;
+}
+
+#define COMPLETION_CACHE_VERSION 1
+
+/* Refresh the completion cache in the background at most this often */
+#define COMPLETION_CACHE_REFRESH_INTERVAL_S 2
+
+static const char *mode_keywords[] = {
+  "highest-refresh",
+  "max-resolution",
+  "max",
+  "native",
+};
+
+static char *
+get_completion_cache_path (void)
+{
+  return g_build_filename (g_get_user_cache_dir (),
+                           "gnome-monitor-config",
+                           "completion",
+                           NULL);
+}
+
+/* Tab separated fields of the monitor lines of the completion cache */
+typedef enum _CompletionCacheField
+{
+  COMPLETION_CACHE_FIELD_CONNECTOR,
+  COMPLETION_CACHE_FIELD_IDENTITY,
+  COMPLETION_CACHE_FIELD_DISPLAY_NAME,
+  COMPLETION_CACHE_FIELD_BUILTIN,
+  COMPLETION_CACHE_FIELD_MODES,
+  N_COMPLETION_CACHE_FIELDS
+} CompletionCacheField;
+
+/*
+ * The cache starts with a line holding its version and the state serial,
+ * followed by one line per monitor with the names -M accepts for it, i.e.
+ * the connector, identity, display name and whether it is built in, and its
+ * space separated mode ids.
+ */
+static char *
+format_completion_cache (CcDisplayState *state)
+{
+  GString *cache;
+  GList *l;
+
+  cache = g_string_new (NULL);
+  g_string_append_printf (cache, "%d %u\n",
+                          COMPLETION_CACHE_VERSION,
+                          cc_display_state_get_serial (state));
+
+  for (l = cc_display_state_get_monitors (state); l; l = l->next)
+    {
+      CcDisplayMonitor *monitor = l->data;
+      g_autofree char *identity = NULL;
+      const char *display_name;
+      GList *k;
+
+      identity = cc_display_monitor_dup_identity (monitor);
+      display_name = cc_display_monitor_get_display_name (monitor);
+      g_string_append_printf (cache, "%s\t%s\t%s\t%d\t",
+                              cc_display_monitor_get_connector (monitor),
+                              identity,
+                              display_name ? display_name : "",
+                              cc_display_monitor_is_builtin_display (monitor));
+      for (k = cc_display_monitor_get_modes (monitor); k; k = k->next)
+        {
+          if (k != cc_display_monitor_get_modes (monitor))
+            g_string_append_c (cache, ' ');
+          g_string_append (cache, cc_display_mode_get_id (k->data));
+        }
+      g_string_append_c (cache, '\n');
+    }
+
+  return g_string_free (cache, FALSE);
+}
+
+/*
+ * Resolves @selector against the monitor lines of the cache like
+ * cc_display_state_lookup_monitor() does against a state, and returns the
+ * fields of the one monitor it selects.
+ */
+static char **
+lookup_completion_cache_monitor (char **lines,
+                                 const char *selector)
+{
+  g_autoptr(GPatternSpec) pattern = NULL;
+  g_auto(GStrv) match = NULL;
+  gboolean ambiguous = FALSE;
+  unsigned int i;
+
+  if (strpbrk (selector, "*?"))
+    pattern = g_pattern_spec_new (selector);
+
+  for (i = 1; lines[i]; i++)
+    {
+      g_auto(GStrv) fields = NULL;
+      gboolean matches;
+      int j;
+
+      fields = g_strsplit (lines[i], "\t", N_COMPLETION_CACHE_FIELDS);
+      if (g_strv_length (fields) != N_COMPLETION_CACHE_FIELDS)
+        continue;
+
+      matches = (g_str_equal (selector, "builtin") &&
+                 g_str_equal (fields[COMPLETION_CACHE_FIELD_BUILTIN], "1"));
+      for (j = 0; !matches && j < COMPLETION_CACHE_FIELD_BUILTIN; j++)
+        {
+          if (!*fields[j])
+            continue;
+
+          matches = (g_str_equal (fields[j], selector) ||
+                     (pattern &&
+                      g_pattern_spec_match_string (pattern, fields[j])));
+        }
+
+      if (!matches)
+        continue;
+
+      if (match)
+        ambiguous = TRUE;
+      else
+        match = g_steal_pointer (&fields);
+    }
+
+  if (ambiguous)
+    return NULL;
+
+  return g_steal_pointer (&match);
+}
+
+static gboolean
+parse_completion_cache_header (const char *contents,
+                               unsigned int *serial)
+{
+  int version;
+
+  return (sscanf (contents, "%d %u", &version, serial) == 2 &&
+          version == COMPLETION_CACHE_VERSION);
+}
+
+/*
+ * Run by 'complete' in the background. The cache is only rewritten when the
+ * serial changed since it was written.
+ */
+static gboolean
+refresh_completion_cache (GError **error)
+{
+  g_autoptr(CcDisplayConfigManager) config_manager = NULL;
+  g_autoptr(CcDisplayState) state = NULL;
+  g_autofree char *path = NULL;
+  g_autofree char *dir = NULL;
+  g_autofree char *old_contents = NULL;
+  g_autofree char *contents = NULL;
+  unsigned int serial;
+
+  state = fetch_current_state (&config_manager, error);
+  if (!state)
+    return FALSE;
+
+  path = get_completion_cache_path ();
+  if (g_file_get_contents (path, &old_contents, NULL, NULL) &&
+      parse_completion_cache_header (old_contents, &serial) &&
+      serial == cc_display_state_get_serial (state))
+    return TRUE;
+
+  dir = g_path_get_dirname (path);
+  if (g_mkdir_with_parents (dir, 0700) != 0)
+    {
+      g_set_error (error, G_IO_ERROR, g_io_error_from_errno (errno),
+                   "Failed to create %s: %s", dir, g_strerror (errno));
+      return FALSE;
+    }
+
+  contents = format_completion_cache (state);
+
+  return g_file_set_contents (path, contents, -1, error);
+}
+
+/*
+ * Starts '__complete refresh' unless the cache was checked recently. The
+ * modification time is bumped first, so that the TABs following in quick
+ * succession don't start more refreshes.
+ */
+static void
+maybe_refresh_completion_cache (const char *path)
+{
+  const char *refresh_argv[] = {
+    g_get_prgname (), "__complete", "refresh", NULL
+  };
+  GStatBuf stat_buf;
+
+  if (g_stat (path, &stat_buf) == 0 &&
+      g_get_real_time () / G_USEC_PER_SEC - stat_buf.st_mtime <
+      COMPLETION_CACHE_REFRESH_INTERVAL_S)
+    return;
+
+  g_utime (path, NULL);
+
+  g_spawn_async (NULL, (char **) refresh_argv, NULL,
+                 G_SPAWN_SEARCH_PATH |
+                 G_SPAWN_STDOUT_TO_DEV_NULL |
+                 G_SPAWN_STDERR_TO_DEV_NULL,
+                 NULL, NULL, NULL, NULL);
+}
+
+/*
+ * Prints the candidates for shell completion, one per line: the connectors
+ * with 'connectors', or the modes of the monitor selected as with -M with
+ * 'modes MONITOR'. They
+ * come from the cache and never from the compositor, which would make TAB
+ * wait for it, so the first completion after the cache went stale may still
+ * offer the previous candidates.
+ */
+static gboolean
+complete (int argc,
+          char **argv,
+          GError **error)
+{
+  g_autofree char *contents = NULL;
+  g_auto(GStrv) lines = NULL;
+  const char *selector = NULL;
+  unsigned int serial;
+  gboolean complete_modes;
+  unsigned int i;
+
+  if (argc < 2)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                   "Missing completion type");
+      return FALSE;
+    }
+
+  if (g_str_equal (argv[1], "refresh"))
+    return refresh_completion_cache (error);
+
+  if (g_str_equal (argv[1], "connectors"))
+    {
+      complete_modes = FALSE;
+    }
+  else if (g_str_equal (argv[1], "modes") && argc > 2)
+    {
+      complete_modes = TRUE;
+      selector = argv[2];
+    }
+  else
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                   "Invalid completion type '%s'", argv[1]);
+      return FALSE;
+    }
+
+  if (state_file)
+    {
+      g_autoptr(CcDisplayConfigManager) config_manager = NULL;
+      g_autoptr(CcDisplayState) state = NULL;
+
+      state = fetch_current_state (&config_manager, error);
+      if (!state)
+        return FALSE;
+
+      contents = format_completion_cache (state);
+    }
+  else
+    {
+      g_autofree char *path = NULL;
+
+      path = get_completion_cache_path ();
+      maybe_refresh_completion_cache (path);
+      g_file_get_contents (path, &contents, NULL, NULL);
+    }
+
+  if (complete_modes)
+    {
+      for (i = 0; i < G_N_ELEMENTS (mode_keywords); i++)
+        g_print ("%s\n", mode_keywords[i]);
+    }
+
+  if (!contents || !parse_completion_cache_header (contents, &serial))
+    return TRUE;
+
+  lines = g_strsplit (contents, "\n", -1);
+  if (complete_modes)
+    {
+      g_auto(GStrv) fields = NULL;
+      g_auto(GStrv) mode_ids = NULL;
+
+      fields = lookup_completion_cache_monitor (lines, selector);
+      if (!fields || !*fields[COMPLETION_CACHE_FIELD_MODES])
+        return TRUE;
+
+      mode_ids = g_strsplit (fields[COMPLETION_CACHE_FIELD_MODES], " ", -1);
+      for (i = 0; mode_ids[i]; i++)
+        g_print ("%s\n", mode_ids[i]);
+
+      return TRUE;
+    }
+
+  for (i = 1; lines[i]; i++)
+    {
+      g_auto(GStrv) fields = NULL;
+
+      fields = g_strsplit (lines[i], "\t", N_COMPLETION_CACHE_FIELDS);
+      if (g_strv_length (fields) == N_COMPLETION_CACHE_FIELDS)
+        g_print ("%s\n", fields[COMPLETION_CACHE_FIELD_CONNECTOR]);
+    }
+
+  return TRUE;
+}
+
+static gboolean
+parse_coordinate (const char *value,
+                  int *coordinate,
+                  GError **error)
+{
+  gint64 parsed;
+
+  if (!g_ascii_string_to_signed (value, 10, G_MININT, G_MAXINT,
+                                 &parsed, error))
+    return FALSE;
+
+  *coordinate = (int) parsed;
+
+  return TRUE;
+}
+
+static void
+print_located_logical_monitor (CcDisplayState *state,
+                               CcDisplayLogicalMonitor *logical_monitor)
+{
+  cairo_rectangle_int_t rect;
+
+  cc_display_logical_monitor_calculate_rect (logical_monitor,
+                                             cc_display_state_get_layout_mode (state),
+                                             &rect);
+  g_print ("Logical monitor [ %dx%d+%d+%d ]%s\n",
+           rect.width, rect.height, rect.x, rect.y,
+           cc_display_logical_monitor_is_primary (logical_monitor) ?
+           ", PRIMARY" : "");
+  list_logical_monitor_monitors (logical_monitor);
+}
+
+/*
+ * Prints the logical monitor containing a point, or with a size, all
+ * logical monitors intersecting that rect, in layout coordinates.
+ */
+static gboolean
+locate (int argc,
+        char **argv,
+        GError **error)
+{
+  g_autoptr(CcDisplayConfigManager) config_manager = NULL;
+  g_autoptr(CcDisplayState) state = NULL;
+  g_autofree CcDisplayLogicalMonitor **logical_monitors = NULL;
+  cairo_rectangle_int_t rect = { .width = 1, .height = 1 };
+  unsigned int n_logical_monitors;
+  unsigned int i;
+
+  if (argc != 3 && argc != 5)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+                   "Expected X Y [WIDTH HEIGHT]");
+      return FALSE;
+    }
+
+  if (!parse_coordinate (argv[1], &rect.x, error) ||
+      !parse_coordinate (argv[2], &rect.y, error))
+    return FALSE;
 
-        case 'p':
-          if (!handle_logical_monitor_primary_arg (error))
-            return FALSE;
-          break;
+  if (argc == 5 &&
+      (!parse_coordinate (argv[3], &rect.width, error) ||
+       !parse_coordinate (argv[4], &rect.height, error)))
+    return FALSE;
 
-        case 'M':
-          if (!handle_monitor_arg (optarg, error))
-            return FALSE;
-          break;
+  state = fetch_current_state (&config_manager, error);
+  if (!state)
+    return FALSE;
 
-	case 'm':
-	  if (!handle_mode_arg (optarg, error))
-            return FALSE;
-          break;
+  if (argc == 3)
+    {
+      CcDisplayLogicalMonitor *logical_monitor;
 
-        case 'h':
-          print_help ();
-          return TRUE;
+      logical_monitor =
+        cc_display_state_lookup_logical_monitor_at (state, rect.x, rect.y);
+      if (!logical_monitor)
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                       "No logical monitor at %d,%d", rect.x, rect.y);
+          return FALSE;
         }
+
+      print_located_logical_monitor (state, logical_monitor);
+      return TRUE;
     }
 
-  if (!finalize_pending_logical_monitor_config ())
+  logical_monitors =
+    g_new (CcDisplayLogicalMonitor *,
+           MAX (cc_display_state_get_n_logical_monitors (state), 1));
+  n_logical_monitors =
+    cc_display_state_find_logical_monitors_in_rect (state, &rect,
+                                                    logical_monitors);
+  if (n_logical_monitors == 0)
     {
-      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-                   "Configuration incomplete");
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND,
+                   "No logical monitor intersects %dx%d+%d+%d",
+                   rect.width, rect.height, rect.x, rect.y);
       return FALSE;
     }
 
-  print_pending_configuration ();
+  for (i = 0; i < n_logical_monitors; i++)
+    print_located_logical_monitor (state, logical_monitors[i]);
 
-  return cc_display_config_manager_apply (config_manager,
-                                          current_state,
-                                          pending_config,
-                                          method,
-                                          error);
+  return TRUE;
 }
 
 static gboolean
 show_monitor_labels (GError **error)
 {
-  GDBusProxy *proxy;
+  g_autoptr(GDBusProxy) proxy = NULL;
   GVariantBuilder builder;
-  CcDisplayConfigManager *config_manager;
+  g_autoptr(CcDisplayConfigManager) config_manager = NULL;
+  g_autoptr(CcDisplayState) state = NULL;
   GList *l;
   int number;
 
@@ -657,19 +2993,14 @@ show_monitor_labels (GError **error)
   if (!proxy)
     return FALSE;
 
-  config_manager = cc_display_config_manager_new (error);
-  if (!config_manager)
-    return FALSE;
-
-  current_state = cc_display_config_manager_new_current_state (config_manager,
-                                                               error);
-  if (!current_state)
+  state = fetch_current_state (&config_manager, error);
+  if (!state)
     return FALSE;
 
   g_variant_builder_init (&builder, G_VARIANT_TYPE ("a{sv}"));
 
   number = 1;
-  for (l = cc_display_state_get_monitors (current_state); l; l = l->next)
+  for (l = cc_display_state_get_monitors (state); l; l = l->next)
     {
       CcDisplayMonitor *monitor = l->data;
 
@@ -695,12 +3026,233 @@ show_monitor_labels (GError **error)
   return TRUE;
 }
 
+static void
+add_bus_address (const char *address)
+{
+  if (!bus_addresses)
+    bus_addresses = g_ptr_array_new_with_free_func (g_free);
+
+  g_ptr_array_add (bus_addresses, g_strdup (address));
+}
+
+static void
+add_all_session_bus_addresses (void)
+{
+  g_autoptr(GDir) dir = NULL;
+  const char *name;
+
+  dir = g_dir_open ("/run/user", 0, NULL);
+  if (!dir)
+    return;
+
+  while ((name = g_dir_read_name (dir)))
+    {
+      g_autofree char *path = NULL;
+      g_autofree char *address = NULL;
+
+      path = g_build_filename ("/run/user", name, "bus", NULL);
+      if (!g_file_test (path, G_FILE_TEST_EXISTS))
+        continue;
+
+      address = g_strdup_printf ("unix:path=%s", path);
+      add_bus_address (address);
+    }
+}
+
+static gboolean
+parse_wait_timeout (const char *value)
+{
+  char *end;
+  double timeout_s;
+
+  timeout_s = g_ascii_strtod (value, &end);
+  if (end == value || *end != '\0' ||
+      !(timeout_s >= 0.0 && timeout_s <= G_MAXINT / 1000))
+    return FALSE;
+
+  wait_timeout_ms = (int) (timeout_s * 1000);
+
+  return TRUE;
+}
+
+typedef struct _BusWait
+{
+  const char *address;
+  int64_t deadline;
+  int64_t waited_us;
+  GError *error;
+} BusWait;
+
+static void
+wait_on_bus (gpointer data,
+             gpointer user_data)
+{
+  BusWait *bus_wait = data;
+  int64_t remaining_us;
+
+  remaining_us = MAX (bus_wait->deadline - g_get_monotonic_time (), 0);
+  cc_display_config_manager_wait_for_compositor (bus_wait->address,
+                                                 remaining_us / 1000,
+                                                 &bus_wait->waited_us,
+                                                 &bus_wait->error);
+}
+
+/*
+ * Several buses are waited on concurrently, all until the same deadline, so
+ * a bus without a compositor neither delays nor aborts the others. Only
+ * failing to reach any of them is an error; 'set' then reports the seats
+ * without a compositor as failed.
+ */
+static gboolean
+wait_for_compositors (GError **error)
+{
+  g_autofree BusWait *bus_waits = NULL;
+  GThreadPool *pool;
+  unsigned int n_appeared = 0;
+  int64_t deadline;
+  unsigned int i;
+
+  if (!bus_addresses || bus_addresses->len == 1)
+    {
+      const char *address;
+      int64_t waited_us;
+
+      address = bus_addresses ? g_ptr_array_index (bus_addresses, 0) : NULL;
+      if (!cc_display_config_manager_wait_for_compositor (address,
+                                                          wait_timeout_ms,
+                                                          &waited_us,
+                                                          error))
+        return FALSE;
+
+      g_printerr ("Waited %.3f s for the compositor%s%s\n",
+                  waited_us / (double) G_USEC_PER_SEC,
+                  address ? " on " : "",
+                  address ? address : "");
+      return TRUE;
+    }
+
+  /* main() only allows a wait without timeout for a single bus */
+  g_assert (wait_timeout_ms >= 0);
+
+  pool = g_thread_pool_new (wait_on_bus, NULL, bus_addresses->len,
+                            FALSE, error);
+  if (!pool)
+    return FALSE;
+
+  deadline = g_get_monotonic_time () + wait_timeout_ms * (int64_t) 1000;
+  bus_waits = g_new0 (BusWait, bus_addresses->len);
+  for (i = 0; i < bus_addresses->len; i++)
+    {
+      bus_waits[i].address = g_ptr_array_index (bus_addresses, i);
+      bus_waits[i].deadline = deadline;
+      g_thread_pool_push (pool, &bus_waits[i], NULL);
+    }
+
+  /* Waits for all pushed buses to be handled. */
+  g_thread_pool_free (pool, FALSE, TRUE);
+
+  for (i = 0; i < bus_addresses->len; i++)
+    {
+      BusWait *bus_wait = &bus_waits[i];
+
+      if (bus_wait->error)
+        {
+          g_printerr ("%s: %s\n", bus_wait->address, bus_wait->error->message);
+          g_clear_error (&bus_wait->error);
+        }
+      else
+        {
+          g_printerr ("Waited %.3f s for the compositor on %s\n",
+                      bus_wait->waited_us / (double) G_USEC_PER_SEC,
+                      bus_wait->address);
+          n_appeared++;
+        }
+    }
+
+  if (n_appeared == 0)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+                   "No compositor appeared on any of %u buses",
+                   bus_addresses->len);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
 int
 main (int argc,
       char *argv[])
 {
   g_set_prgname (argv[0]);
 
+  while (argc > 1 && g_str_has_prefix (argv[1], "--"))
+    {
+      if (g_str_has_prefix (argv[1], "--state-from="))
+        {
+          state_file = argv[1] + strlen ("--state-from=");
+          argc--;
+          argv++;
+        }
+      else if (g_str_equal (argv[1], "--state-from") && argc > 2)
+        {
+          state_file = argv[2];
+          argc -= 2;
+          argv += 2;
+        }
+      else if (g_str_has_prefix (argv[1], "--bus="))
+        {
+          add_bus_address (argv[1] + strlen ("--bus="));
+          argc--;
+          argv++;
+        }
+      else if (g_str_equal (argv[1], "--bus") && argc > 2)
+        {
+          add_bus_address (argv[2]);
+          argc -= 2;
+          argv += 2;
+        }
+      else if (g_str_equal (argv[1], "--wait"))
+        {
+          wait_for_compositor = TRUE;
+          argc--;
+          argv++;
+        }
+      else if (g_str_has_prefix (argv[1], "--wait="))
+        {
+          if (!parse_wait_timeout (argv[1] + strlen ("--wait=")))
+            {
+              g_printerr ("Invalid timeout '%s'\n",
+                          argv[1] + strlen ("--wait="));
+              return EXIT_FAILURE;
+            }
+          wait_for_compositor = TRUE;
+          argc--;
+          argv++;
+        }
+      else if (g_str_equal (argv[1], "--verbose"))
+        {
+          g_setenv ("G_MESSAGES_DEBUG", "gnome-monitor-config", TRUE);
+          argc--;
+          argv++;
+        }
+      else if (g_str_equal (argv[1], "--all-sessions"))
+        {
+          add_all_session_bus_addresses ();
+          if (!bus_addresses)
+            {
+              g_printerr ("No session buses found\n");
+              return EXIT_FAILURE;
+            }
+          argc--;
+          argv++;
+        }
+      else
+        {
+          break;
+        }
+    }
+
   if (argc == 1)
     {
       print_usage (stderr);
@@ -713,11 +3265,43 @@ main (int argc,
       return EXIT_SUCCESS;
     }
 
-  if (g_str_equal (argv[1], "list") && argc == 2)
+  if (bus_addresses && !g_str_equal (argv[1], "set"))
+    {
+      g_printerr ("Only 'set' supports --bus and --all-sessions\n");
+      return EXIT_FAILURE;
+    }
+
+  if (bus_addresses && state_file)
+    {
+      g_printerr ("--state-from can't be combined with --bus or --all-sessions\n");
+      return EXIT_FAILURE;
+    }
+
+  if (wait_for_compositor && wait_timeout_ms < 0 &&
+      bus_addresses && bus_addresses->len > 1)
+    {
+      g_printerr ("--wait needs a TIMEOUT with several buses\n");
+      return EXIT_FAILURE;
+    }
+
+  if (wait_for_compositor && !state_file)
+    {
+      GError *error = NULL;
+
+      if (!wait_for_compositors (&error))
+        {
+          g_printerr ("Failed to wait for the compositor: %s\n",
+                      error->message);
+          g_error_free (error);
+          return EXIT_FAILURE;
+        }
+    }
+
+  if (g_str_equal (argv[1], "list"))
     {
       GError *error = NULL;
 
-      if (!list_monitors (&error))
+      if (!list_monitors (argc - 1, argv + 1, &error))
         {
           g_printerr ("Failed to list current configuration: %s\n",
                       error->message);
@@ -761,6 +3345,134 @@ main (int argc,
           return EXIT_SUCCESS;
         }
     }
+  else if (g_str_equal (argv[1], "list-stored"))
+    {
+      GError *error = NULL;
+
+      if (!list_stored_configs (argc - 1, argv + 1, &error))
+        {
+          g_printerr ("Failed to list stored configurations: %s\n",
+                      error->message);
+          g_error_free (error);
+          return EXIT_FAILURE;
+        }
+      else
+        {
+          return EXIT_SUCCESS;
+        }
+    }
+  else if (g_str_equal (argv[1], "apply-stored"))
+    {
+      GError *error = NULL;
+
+      if (!apply_stored_config (argc - 1, argv + 1, &error))
+        {
+          g_printerr ("Failed to apply stored configuration: %s\n",
+                      error->message);
+          g_error_free (error);
+          return EXIT_FAILURE;
+        }
+      else
+        {
+          return EXIT_SUCCESS;
+        }
+    }
+  else if (g_str_equal (argv[1], "watch"))
+    {
+      GError *error = NULL;
+
+      if (!watch_monitors (argc - 1, argv + 1, &error))
+        {
+          g_printerr ("Failed to watch monitors: %s\n",
+                      error->message);
+          g_error_free (error);
+          return EXIT_FAILURE;
+        }
+      else
+        {
+          return EXIT_SUCCESS;
+        }
+    }
+  else if (g_str_equal (argv[1], "locate"))
+    {
+      GError *error = NULL;
+
+      if (!locate (argc - 1, argv + 1, &error))
+        {
+          g_printerr ("Failed to locate monitors: %s\n",
+                      error->message);
+          g_error_free (error);
+          return EXIT_FAILURE;
+        }
+      else
+        {
+          return EXIT_SUCCESS;
+        }
+    }
+  else if (g_str_equal (argv[1], "__complete"))
+    {
+      GError *error = NULL;
+
+      if (!complete (argc - 1, argv + 1, &error))
+        {
+          g_printerr ("Failed to complete: %s\n",
+                      error->message);
+          g_error_free (error);
+          return EXIT_FAILURE;
+        }
+      else
+        {
+          return EXIT_SUCCESS;
+        }
+    }
+  else if (g_str_equal (argv[1], "confirm"))
+    {
+      GError *error = NULL;
+
+      if (!confirm_config (&error))
+        {
+          g_printerr ("Failed to confirm configuration: %s\n",
+                      error->message);
+          g_error_free (error);
+          return EXIT_FAILURE;
+        }
+      else
+        {
+          return EXIT_SUCCESS;
+        }
+    }
+  else if (g_str_equal (argv[1], "preview-batch"))
+    {
+      GError *error = NULL;
+
+      if (!preview_batch (argc - 1, argv + 1, &error))
+        {
+          g_printerr ("Failed to preview layouts: %s\n",
+                      error->message);
+          g_error_free (error);
+          return EXIT_FAILURE;
+        }
+      else
+        {
+          return EXIT_SUCCESS;
+        }
+    }
+  else if (g_str_equal (argv[1], "power"))
+    {
+      GError *error = NULL;
+
+      if (!set_power_save_mode (argc - 1, argv + 1, &error))
+        {
+          g_printerr ("Failed to change power save mode: %s\n",
+                      error->message);
+          g_error_free (error);
+          return EXIT_FAILURE;
+        }
+      else
+        {
+          return EXIT_SUCCESS;
+        }
+    }
   else
     {
       print_usage (stderr);
@@ -0,0 +1,536 @@
+/*
+ * Copyright (C) 2026  The gnome-monitor-config authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#include "gmc-display-transition.h"
+
+#include <gio/gio.h>
+
+#include "gmc-rect.h"
+
+/*
+ * Upper bound of monitors considered for intermediate steps; the planner
+ * tries every subset of them.
+ */
+#define MAX_PLANNED_MONITORS 16
+
+typedef struct _CcDisplayTransitionStep
+{
+  CcDisplayConfig *config;
+  bool owns_config;
+  int n_mode_changes;
+} CcDisplayTransitionStep;
+
+struct _CcDisplayTransition
+{
+  GArray *steps;
+};
+
+static GArray *
+get_config_rects (CcDisplayConfig *config,
+                  CcDisplayLayoutMode layout_mode)
+{
+  GArray *rects;
+  GList *l;
+
+  rects = g_array_new (FALSE, FALSE, sizeof (cairo_rectangle_int_t));
+  for (l = cc_display_config_get_logical_logical_monitor_configs (config);
+       l;
+       l = l->next)
+    {
+      cairo_rectangle_int_t rect;
+
+      cc_display_logical_monitor_config_calculate_rect (l->data, layout_mode,
+                                                        &rect);
+      g_array_append_val (rects, rect);
+    }
+
+  return rects;
+}
+
+static GHashTable *
+get_config_modes (CcDisplayConfig *config)
+{
+  GHashTable *modes;
+  GList *l;
+
+  modes = g_hash_table_new (NULL, NULL);
+  for (l = cc_display_config_get_logical_logical_monitor_configs (config);
+       l;
+       l = l->next)
+    {
+      GList *k;
+
+      for (k = cc_display_logical_monitor_config_get_monitor_configs (l->data);
+           k;
+           k = k->next)
+        {
+          CcDisplayMonitorConfig *monitor_config = k->data;
+
+          g_hash_table_insert (modes,
+                               cc_display_monitor_config_get_monitor (monitor_config),
+                               cc_display_monitor_config_get_mode (monitor_config));
+        }
+    }
+
+  return modes;
+}
+
+static int
+count_mode_changes (CcDisplayState *state,
+                    GHashTable *from_modes,
+                    GHashTable *to_modes)
+{
+  int n_mode_changes = 0;
+  GList *l;
+
+  for (l = cc_display_state_get_monitors (state); l; l = l->next)
+    {
+      if (g_hash_table_lookup (from_modes, l->data) !=
+          g_hash_table_lookup (to_modes, l->data))
+        n_mode_changes++;
+    }
+
+  return n_mode_changes;
+}
+
+/*
+ * Checks the constraints the compositor puts on a layout: no overlaps and
+ * every logical monitor touching another one.
+ */
+static bool
+is_layout_valid (GArray *rects)
+{
+  unsigned int i, j;
+
+  if (rects->len == 0)
+    return false;
+
+  for (i = 0; i < rects->len; i++)
+    {
+      cairo_rectangle_int_t *rect =
+        &g_array_index (rects, cairo_rectangle_int_t, i);
+      bool has_neighbour = rects->len == 1;
+
+      for (j = 0; j < rects->len; j++)
+        {
+          cairo_rectangle_int_t *other =
+            &g_array_index (rects, cairo_rectangle_int_t, j);
+
+          if (i == j)
+            continue;
+
+          if (gmc_rect_overlaps (rect, other))
+            return false;
+
+          if (gmc_rect_is_adjacent (rect, other))
+            has_neighbour = true;
+        }
+
+      if (!has_neighbour)
+        return false;
+    }
+
+  return true;
+}
+
+gboolean
+cc_display_config_is_layout_valid (CcDisplayConfig *config,
+                                   CcDisplayLayoutMode layout_mode)
+{
+  g_autoptr(GArray) rects = NULL;
+
+  rects = get_config_rects (config, layout_mode);
+
+  return is_layout_valid (rects);
+}
+
+/*
+ * While switching from one layout to the next, the screen temporarily has to
+ * contain both of them.
+ */
+static bool
+transition_fits (GArray *from_rects,
+                 GArray *to_rects,
+                 int max_width,
+                 int max_height)
+{
+  GArray *rect_arrays[] = { from_rects, to_rects };
+  int width = 0, height = 0;
+  unsigned int i, j;
+
+  for (i = 0; i < G_N_ELEMENTS (rect_arrays); i++)
+    {
+      for (j = 0; j < rect_arrays[i]->len; j++)
+        {
+          cairo_rectangle_int_t *rect =
+            &g_array_index (rect_arrays[i], cairo_rectangle_int_t, j);
+
+          width = MAX (width, rect->x + rect->width);
+          height = MAX (height, rect->y + rect->height);
+        }
+    }
+
+  return width <= max_width && height <= max_height;
+}
+
+/*
+ * Creates a configuration reproducing the current state, except for the
+ * monitors selected by @disabled_mask, which are turned off. The result is
+ * moved back to the origin, as required by the compositor.
+ */
+static CcDisplayConfig *
+create_current_config (CcDisplayState *state,
+                       GPtrArray *candidates,
+                       unsigned int disabled_mask,
+                       CcDisplayLayoutMode layout_mode)
+{
+  g_autoptr(CcDisplayConfig) config = NULL;
+  g_autoptr(GArray) rects = NULL;
+  bool has_primary = false;
+  int min_x = G_MAXINT, min_y = G_MAXINT;
+  GList *logical_monitor_configs;
+  GList *l;
+  unsigned int i;
+
+  config = cc_display_config_new ();
+
+  for (l = cc_display_state_get_logical_monitors (state); l; l = l->next)
+    {
+      CcDisplayLogicalMonitor *logical_monitor = l->data;
+      CcDisplayLogicalMonitorConfig *logical_monitor_config = NULL;
+      cairo_rectangle_int_t layout;
+      GList *k;
+
+      for (k = cc_display_logical_monitor_get_monitors (logical_monitor);
+           k;
+           k = k->next)
+        {
+          CcDisplayMonitor *monitor = k->data;
+          unsigned int index;
+
+          if (g_ptr_array_find (candidates, monitor, &index) &&
+              disabled_mask & (1u << index))
+            continue;
+
+          if (!logical_monitor_config)
+            {
+              logical_monitor_config = cc_display_logical_monitor_config_new ();
+              cc_display_logical_monitor_calculate_layout (logical_monitor,
+                                                           &layout);
+              cc_display_logical_monitor_config_set_position (logical_monitor_config,
+                                                              layout.x,
+                                                              layout.y);
+              cc_display_logical_monitor_config_set_scale (logical_monitor_config,
+                                                           cc_display_logical_monitor_get_scale (logical_monitor));
+              cc_display_logical_monitor_config_set_transform (logical_monitor_config,
+                                                               cc_display_logical_monitor_get_transform (logical_monitor));
+              cc_display_logical_monitor_config_set_is_primary (logical_monitor_config,
+                                                                cc_display_logical_monitor_is_primary (logical_monitor));
+            }
+
+          cc_display_logical_monitor_config_add_monitor (logical_monitor_config,
+                                                         monitor,
+                                                         cc_display_monitor_get_current_mode (monitor));
+        }
+
+      if (!logical_monitor_config)
+        continue;
+
+      if (cc_display_logical_monitor_config_is_primary (logical_monitor_config))
+        has_primary = true;
+
+      cc_display_config_add_logical_monitor (config, logical_monitor_config);
+    }
+
+  logical_monitor_configs =
+    cc_display_config_get_logical_logical_monitor_configs (config);
+  if (!logical_monitor_configs)
+    return NULL;
+
+  if (!has_primary)
+    cc_display_logical_monitor_config_set_is_primary (logical_monitor_configs->data,
+                                                      true);
+
+  rects = get_config_rects (config, layout_mode);
+  for (i = 0; i < rects->len; i++)
+    {
+      cairo_rectangle_int_t *rect =
+        &g_array_index (rects, cairo_rectangle_int_t, i);
+
+      min_x = MIN (min_x, rect->x);
+      min_y = MIN (min_y, rect->y);
+    }
+
+  for (l = logical_monitor_configs; l; l = l->next)
+    {
+      int x, y;
+
+      cc_display_logical_monitor_config_get_position (l->data, &x, &y);
+      cc_display_logical_monitor_config_set_position (l->data,
+                                                      x - min_x, y - min_y);
+    }
+
+  return g_steal_pointer (&config);
+}
+
+static unsigned int
+count_bits (unsigned int mask)
+{
+  unsigned int n_bits = 0;
+
+  for (; mask; mask &= mask - 1)
+    n_bits++;
+
+  return n_bits;
+}
+
+static void
+add_step (CcDisplayTransition *transition,
+          CcDisplayConfig *config,
+          bool owns_config,
+          int n_mode_changes)
+{
+  CcDisplayTransitionStep step = {
+    .config = config,
+    .owns_config = owns_config,
+    .n_mode_changes = n_mode_changes
+  };
+
+  g_array_append_val (transition->steps, step);
+}
+
+static void
+clear_step (CcDisplayTransitionStep *step)
+{
+  if (step->owns_config)
+    cc_display_config_free (step->config);
+}
+
+/*
+ * Looks for the cheapest intermediate configuration, counted in monitors
+ * changing mode, that avoids exceeding the maximum screen size. Intermediate
+ * configurations are the current one with some of the monitors that change
+ * mode anyway turned off, so trying them by increasing number of disabled
+ * monitors finds the cheapest one first.
+ *
+ * Only a single intermediate step is planned; sequences of several are not
+ * searched, so this fails if no single one fits.
+ */
+static bool
+plan_intermediate_step (CcDisplayTransition *transition,
+                        CcDisplayState *state,
+                        CcDisplayConfig *config,
+                        CcDisplayLayoutMode layout_mode,
+                        int max_width,
+                        int max_height)
+{
+  g_autoptr(GPtrArray) candidates = NULL;
+  g_autoptr(GHashTable) current_modes = NULL;
+  g_autoptr(GHashTable) target_modes = NULL;
+  g_autoptr(GArray) target_rects = NULL;
+  unsigned int n_disabled;
+  GList *l;
+
+  target_modes = get_config_modes (config);
+  target_rects = get_config_rects (config, layout_mode);
+
+  candidates = g_ptr_array_new ();
+  for (l = cc_display_state_get_monitors (state); l; l = l->next)
+    {
+      CcDisplayMonitor *monitor = l->data;
+      CcDisplayMode *current_mode;
+
+      if (!cc_display_monitor_is_active (monitor))
+        continue;
+
+      current_mode = cc_display_monitor_get_current_mode (monitor);
+      if (g_hash_table_lookup (target_modes, monitor) != current_mode)
+        g_ptr_array_add (candidates, monitor);
+    }
+
+  if (candidates->len == 0 || candidates->len > MAX_PLANNED_MONITORS)
+    return false;
+
+  for (n_disabled = 1; n_disabled <= candidates->len; n_disabled++)
+    {
+      unsigned int mask;
+
+      for (mask = 1; mask < (1u << candidates->len); mask++)
+        {
+          g_autoptr(CcDisplayConfig) intermediate_config = NULL;
+          g_autoptr(GArray) intermediate_rects = NULL;
+          g_autoptr(GHashTable) intermediate_modes = NULL;
+
+          if (count_bits (mask) != n_disabled)
+            continue;
+
+          intermediate_config = create_current_config (state, candidates,
+                                                       mask, layout_mode);
+          if (!intermediate_config)
+            continue;
+
+          intermediate_rects = get_config_rects (intermediate_config,
+                                                 layout_mode);
+          if (!is_layout_valid (intermediate_rects) ||
+              !transition_fits (intermediate_rects, target_rects,
+                                max_width, max_height))
+            continue;
+
+          if (!current_modes)
+            {
+              g_autoptr(CcDisplayConfig) current_config = NULL;
+
+              current_config = create_current_config (state, candidates,
+                                                      0, layout_mode);
+              current_modes = get_config_modes (current_config);
+            }
+
+          intermediate_modes = get_config_modes (intermediate_config);
+          add_step (transition, g_steal_pointer (&intermediate_config), true,
+                    count_mode_changes (state, current_modes,
+                                        intermediate_modes));
+          add_step (transition, config, false,
+                    count_mode_changes (state, intermediate_modes,
+                                        target_modes));
+
+          return true;
+        }
+    }
+
+  return false;
+}
+
+CcDisplayTransition *
+cc_display_transition_new (CcDisplayState *state,
+                           CcDisplayConfig *config,
+                           GError **error)
+{
+  CcDisplayTransition *transition;
+  g_autoptr(CcDisplayConfig) current_config = NULL;
+  g_autoptr(GHashTable) current_modes = NULL;
+  g_autoptr(GHashTable) target_modes = NULL;
+  g_autoptr(GPtrArray) no_candidates = NULL;
+  CcDisplayLayoutMode layout_mode;
+  int max_width, max_height;
+  int n_mode_changes;
+
+  transition = g_new0 (CcDisplayTransition, 1);
+  transition->steps = g_array_new (FALSE, FALSE,
+                                   sizeof (CcDisplayTransitionStep));
+  g_array_set_clear_func (transition->steps, (GDestroyNotify) clear_step);
+
+  if (!cc_display_config_get_layout_mode (config, &layout_mode))
+    layout_mode = cc_display_state_get_layout_mode (state);
+
+  no_candidates = g_ptr_array_new ();
+  current_config = create_current_config (state, no_candidates, 0,
+                                          layout_mode);
+  target_modes = get_config_modes (config);
+  if (current_config)
+    current_modes = get_config_modes (current_config);
+  else
+    current_modes = g_hash_table_new (NULL, NULL);
+
+  n_mode_changes = count_mode_changes (state, current_modes, target_modes);
+
+  /*
+   * A single step is enough when nothing but position, scale, transform or
+   * primary changes, or when the screen size isn't limited.
+   */
+  if (n_mode_changes > 0 &&
+      current_config &&
+      cc_display_state_get_max_screen_size (state, &max_width, &max_height))
+    {
+      g_autoptr(GArray) current_rects = NULL;
+      g_autoptr(GArray) target_rects = NULL;
+
+      current_rects = get_config_rects (current_config, layout_mode);
+      target_rects = get_config_rects (config, layout_mode);
+      if (!transition_fits (current_rects, target_rects,
+                            max_width, max_height))
+        {
+          if (!plan_intermediate_step (transition, state, config, layout_mode,
+                                       max_width, max_height))
+            {
+              g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                           "No valid plan: the configuration can't be reached "
+                           "within the maximum screen size of %dx%d with at "
+                           "most one intermediate configuration",
+                           max_width, max_height);
+              cc_display_transition_free (transition);
+              return NULL;
+            }
+
+          return transition;
+        }
+    }
+
+  add_step (transition, config, false, n_mode_changes);
+
+  return transition;
+}
+
+void
+cc_display_transition_free (CcDisplayTransition *transition)
+{
+  g_array_unref (transition->steps);
+  g_free (transition);
+}
+
+unsigned int
+cc_display_transition_get_n_steps (CcDisplayTransition *transition)
+{
+  return transition->steps->len;
+}
+
+CcDisplayConfig *
+cc_display_transition_get_step_config (CcDisplayTransition *transition,
+                                       unsigned int step)
+{
+  g_return_val_if_fail (step < transition->steps->len, NULL);
+
+  return g_array_index (transition->steps, CcDisplayTransitionStep,
+                        step).config;
+}
+
+int
+cc_display_transition_get_step_n_mode_changes (CcDisplayTransition *transition,
+                                               unsigned int step)
+{
+  g_return_val_if_fail (step < transition->steps->len, 0);
+
+  return g_array_index (transition->steps, CcDisplayTransitionStep,
+                        step).n_mode_changes;
+}
+
+int
+cc_display_transition_get_n_mode_changes (CcDisplayTransition *transition)
+{
+  int n_mode_changes = 0;
+  unsigned int i;
+
+  for (i = 0; i < transition->steps->len; i++)
+    {
+      n_mode_changes += g_array_index (transition->steps,
+                                       CcDisplayTransitionStep,
+                                       i).n_mode_changes;
+    }
+
+  return n_mode_changes;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2026  The gnome-monitor-config authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _CC_DISPLAY_TRANSITION_H
+#define _CC_DISPLAY_TRANSITION_H
+
+#include <glib.h>
+
+#include "gmc-display-config.h"
+
+typedef struct _CcDisplayTransition CcDisplayTransition;
+
+/*
+ * A transition is the sequence of configurations applied to get from @state
+ * to @config. The last step is always @config itself, which must outlive the
+ * transition. When switching directly would exceed the maximum screen size,
+ * at most one intermediate configuration is inserted; if none fits, there is
+ * no valid plan and NULL is returned.
+ */
+CcDisplayTransition * cc_display_transition_new (CcDisplayState *state,
+                                                 CcDisplayConfig *config,
+                                                 GError **error);
+void cc_display_transition_free (CcDisplayTransition *transition);
+
+/*
+ * Checks the constraints the compositor puts on the layout of @config, the
+ * same the planner checks its intermediate configurations against: no
+ * overlaps and every logical monitor touching another one.
+ */
+gboolean cc_display_config_is_layout_valid (CcDisplayConfig *config,
+                                            CcDisplayLayoutMode layout_mode);
+
+unsigned int cc_display_transition_get_n_steps (CcDisplayTransition *transition);
+CcDisplayConfig * cc_display_transition_get_step_config (CcDisplayTransition *transition,
+                                                         unsigned int step);
+int cc_display_transition_get_step_n_mode_changes (CcDisplayTransition *transition,
+                                                   unsigned int step);
+int cc_display_transition_get_n_mode_changes (CcDisplayTransition *transition);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (CcDisplayTransition, cc_display_transition_free)
+
+#endif /* _CC_DISPLAY_TRANSITION_H */
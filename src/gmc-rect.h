@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2026  The gnome-monitor-config authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _GMC_RECT_H
+#define _GMC_RECT_H
+
+#include <cairo.h>
+#include <glib.h>
+#include <stdbool.h>
+
+static inline bool
+gmc_rect_overlaps (const cairo_rectangle_int_t *a,
+                   const cairo_rectangle_int_t *b)
+{
+  return (a->x < b->x + b->width && b->x < a->x + a->width &&
+          a->y < b->y + b->height && b->y < a->y + a->height);
+}
+
+/* Whether @a and @b share part of an edge */
+static inline bool
+gmc_rect_is_adjacent (const cairo_rectangle_int_t *a,
+                      const cairo_rectangle_int_t *b)
+{
+  if (a->x + a->width == b->x || b->x + b->width == a->x)
+    return a->y < b->y + b->height && b->y < a->y + a->height;
+
+  if (a->y + a->height == b->y || b->y + b->height == a->y)
+    return a->x < b->x + b->width && b->x < a->x + a->width;
+
+  return false;
+}
+
+static inline bool
+gmc_rect_intersect (const cairo_rectangle_int_t *a,
+                    const cairo_rectangle_int_t *b,
+                    cairo_rectangle_int_t *intersection)
+{
+  int x1, y1, x2, y2;
+
+  x1 = MAX (a->x, b->x);
+  y1 = MAX (a->y, b->y);
+  x2 = MIN (a->x + a->width, b->x + b->width);
+  y2 = MIN (a->y + a->height, b->y + b->height);
+  if (x1 >= x2 || y1 >= y2)
+    return false;
+
+  *intersection = (cairo_rectangle_int_t) {
+    .x = x1,
+    .y = y1,
+    .width = x2 - x1,
+    .height = y2 - y1
+  };
+  return true;
+}
+
+static inline void
+gmc_rect_union (const cairo_rectangle_int_t *a,
+                const cairo_rectangle_int_t *b,
+                cairo_rectangle_int_t *dest)
+{
+  int x1, y1, x2, y2;
+
+  x1 = MIN (a->x, b->x);
+  y1 = MIN (a->y, b->y);
+  x2 = MAX (a->x + a->width, b->x + b->width);
+  y2 = MAX (a->y + a->height, b->y + b->height);
+
+  *dest = (cairo_rectangle_int_t) {
+    .x = x1,
+    .y = y1,
+    .width = x2 - x1,
+    .height = y2 - y1
+  };
+}
+
+#endif /* _GMC_RECT_H */
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2026  The gnome-monitor-config authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+#ifndef _GMC_TRACE_H
+#define _GMC_TRACE_H
+
+#include <glib.h>
+
+#if defined (HAVE_SYSPROF)
+#include <sysprof-capture.h>
+#elif defined (HAVE_USDT)
+#include <sys/sdt.h>
+#endif
+
+/*
+ * GMC_TRACE_BEGIN() and GMC_TRACE_END() bracket a traced section. Built with
+ * -Dtracing=sysprof, the section is recorded as a mark in the
+ * "gnome-monitor-config" group of the sysprof capture; with -Dtracing=usdt it
+ * fires the USDT probe gnome_monitor_config:NAME with the duration in
+ * microseconds followed by the payload. Otherwise the payload is not even
+ * evaluated.
+ *
+ * The payload is the number of monitors, the number of modes and the size in
+ * bytes of the D-Bus data involved; fields that don't apply are 0.
+ */
+#if defined (HAVE_SYSPROF)
+
+#define GMC_TRACE_BEGIN(name) \
+  G_GNUC_UNUSED gint64 gmc_trace_begin_##name = SYSPROF_CAPTURE_CURRENT_TIME
+
+#define GMC_TRACE_END(name, n_monitors, n_modes, n_bytes) \
+  sysprof_collector_mark_printf (gmc_trace_begin_##name, \
+                                 SYSPROF_CAPTURE_CURRENT_TIME - \
+                                 gmc_trace_begin_##name, \
+                                 "gnome-monitor-config", #name, \
+                                 "monitors=%u modes=%u bytes=%" G_GSIZE_FORMAT, \
+                                 (unsigned int) (n_monitors), \
+                                 (unsigned int) (n_modes), \
+                                 (gsize) (n_bytes))
+
+#elif defined (HAVE_USDT)
+
+#define GMC_TRACE_BEGIN(name) \
+  G_GNUC_UNUSED gint64 gmc_trace_begin_##name = g_get_monotonic_time ()
+
+#define GMC_TRACE_END(name, n_monitors, n_modes, n_bytes) \
+  DTRACE_PROBE4 (gnome_monitor_config, name, \
+                 g_get_monotonic_time () - gmc_trace_begin_##name, \
+                 (unsigned int) (n_monitors), \
+                 (unsigned int) (n_modes), \
+                 (gsize) (n_bytes))
+
+#else
+
+#define GMC_TRACE_BEGIN(name) G_STMT_START { } G_STMT_END
+
+#define GMC_TRACE_END(name, n_monitors, n_modes, n_bytes) \
+  G_STMT_START { \
+    if (0) \
+      { \
+        (void) (n_monitors); \
+        (void) (n_modes); \
+        (void) (n_bytes); \
+      } \
+  } G_STMT_END
+
+#endif
+
+/*
+ * Debug output goes through GLib logging in the "gnome-monitor-config"
+ * domain and is shown with G_MESSAGES_DEBUG=gnome-monitor-config. Use this to
+ * skip building expensive messages nobody will see.
+ */
+static inline gboolean
+gmc_debug_enabled (void)
+{
+  return !g_log_writer_default_would_drop (G_LOG_LEVEL_DEBUG, G_LOG_DOMAIN);
+}
+
+#endif /* _GMC_TRACE_H */
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2026  The gnome-monitor-config authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include <gio/gio.h>
+#include <stdlib.h>
+
+#include "gmc-display-config-manager.h"
+#include "gmc-mock-display-config.h"
+
+#define COLD_START_N_RUNS 200
+
+/*
+ * Median time from creating a manager to a parsed state for one-shot commands
+ * such as 'list' run from login scripts; it is a handful of round trips to a
+ * local bus, so even loaded machines stay well below this.
+ */
+#define COLD_START_TARGET_US (20 * 1000)
+
+static int
+compare_durations (gconstpointer a,
+                   gconstpointer b)
+{
+  const int64_t *duration_a = a;
+  const int64_t *duration_b = b;
+
+  return (*duration_a > *duration_b) - (*duration_a < *duration_b);
+}
+
+/*
+ * Returns the median time from creating a manager to its first state. The
+ * managers share the session bus connection, as the commands of one process
+ * would.
+ */
+static int64_t
+measure_cold_start (CcDisplayConfigManagerFlags flags)
+{
+  int64_t durations[COLD_START_N_RUNS];
+  unsigned int i;
+
+  for (i = 0; i < COLD_START_N_RUNS; i++)
+    {
+      g_autoptr(CcDisplayConfigManager) manager = NULL;
+      g_autoptr(GError) error = NULL;
+      CcDisplayState *state;
+      int64_t start_time;
+
+      start_time = g_get_monotonic_time ();
+      manager = cc_display_config_manager_new_with_flags (flags, &error);
+      g_assert_no_error (error);
+      state = cc_display_config_manager_new_current_state (manager, &error);
+      g_assert_no_error (error);
+      durations[i] = g_get_monotonic_time () - start_time;
+
+      cc_display_state_free (state);
+    }
+
+  qsort (durations, COLD_START_N_RUNS, sizeof (int64_t), compare_durations);
+
+  return durations[COLD_START_N_RUNS / 2];
+}
+
+static void
+test_cold_start (void)
+{
+  g_autoptr(GTestDBus) bus = NULL;
+  g_autoptr(CcMockDisplayConfig) mock = NULL;
+  g_autoptr(GError) error = NULL;
+  int64_t one_shot_us, full_us;
+
+  bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (bus);
+
+  mock = cc_mock_display_config_new (g_test_dbus_get_bus_address (bus),
+                                     &error);
+  g_assert_no_error (error);
+
+  full_us = measure_cold_start (CC_DISPLAY_CONFIG_MANAGER_FLAGS_NONE);
+  one_shot_us = measure_cold_start (CC_DISPLAY_CONFIG_MANAGER_FLAGS_ONE_SHOT);
+
+  g_test_minimized_result (one_shot_us / (double) G_USEC_PER_SEC,
+                           "One-shot cold start: %" G_GINT64_FORMAT " us, "
+                           "with proxy: %" G_GINT64_FORMAT " us",
+                           one_shot_us, full_us);
+
+  /* Skipping the property loading and signal subscription has to show */
+  g_assert_cmpint (one_shot_us, <, full_us);
+  g_assert_cmpint (one_shot_us, <=, COLD_START_TARGET_US);
+
+  g_clear_pointer (&mock, cc_mock_display_config_free);
+  g_test_dbus_down (bus);
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/benchmark/cold-start", test_cold_start);
+
+  return g_test_run ();
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright (C) 2026  The gnome-monitor-config authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include <glib.h>
+#include <stdint.h>
+
+#include "gmc-display-config.h"
+#include "gmc-mock-display-config.h"
+
+#define HASH_N_LAYOUTS 1000
+#define HASH_N_STATES 1000
+#define HASH_N_REPORTS 1000000
+
+static CcDisplayState *
+new_state (unsigned int serial)
+{
+  g_autoptr(GVariant) state_variant = NULL;
+  g_autoptr(GError) error = NULL;
+  CcDisplayState *state;
+
+  state_variant = cc_mock_display_config_new_state_variant (serial);
+  state = cc_display_state_new_from_variant (state_variant, &error);
+  g_assert_no_error (error);
+
+  return state;
+}
+
+/*
+ * Layouts differ in the vertical offset of the external monitor. With
+ * @reversed, the logical monitors are added the other way round.
+ */
+static CcDisplayConfig *
+new_layout (CcDisplayState *state,
+            unsigned int layout,
+            gboolean reversed)
+{
+  CcDisplayConfig *config;
+  GList *monitors;
+  GList *l;
+
+  config = cc_display_config_new ();
+  cc_display_config_set_layout_mode (config, CC_DISPLAY_LAYOUT_MODE_LOGICAL);
+
+  monitors = cc_display_state_get_monitors (state);
+  for (l = reversed ? g_list_last (monitors) : monitors;
+       l;
+       l = reversed ? l->prev : l->next)
+    {
+      CcDisplayMonitor *monitor = l->data;
+      CcDisplayLogicalMonitorConfig *logical_monitor_config;
+
+      logical_monitor_config = cc_display_logical_monitor_config_new ();
+      if (cc_display_monitor_is_builtin_display (monitor))
+        {
+          cc_display_logical_monitor_config_set_position (logical_monitor_config,
+                                                          0, 0);
+          cc_display_logical_monitor_config_set_scale (logical_monitor_config,
+                                                       2.0);
+        }
+      else
+        {
+          cc_display_logical_monitor_config_set_position (logical_monitor_config,
+                                                          1280, layout);
+          cc_display_logical_monitor_config_set_scale (logical_monitor_config,
+                                                       1.5);
+          cc_display_logical_monitor_config_set_is_primary (logical_monitor_config,
+                                                            TRUE);
+        }
+      cc_display_logical_monitor_config_add_monitor (logical_monitor_config,
+                                                     monitor,
+                                                     cc_display_monitor_get_current_mode (monitor));
+      cc_display_config_add_logical_monitor (config, logical_monitor_config);
+    }
+
+  return config;
+}
+
+/*
+ * Deduplicates reported layouts, each reported from two separately parsed
+ * states and with the logical monitors in both orders.
+ */
+static void
+test_config_hash (void)
+{
+  g_autoptr(CcDisplayState) state = NULL;
+  g_autoptr(CcDisplayState) other_state = NULL;
+  g_autoptr(GPtrArray) reports = NULL;
+  g_autoptr(GHashTable) layouts = NULL;
+  int64_t start_time, duration_us;
+  unsigned int i;
+
+  state = new_state (1);
+  other_state = new_state (2);
+
+  reports = g_ptr_array_new_with_free_func ((GDestroyNotify) cc_display_config_free);
+  for (i = 0; i < HASH_N_LAYOUTS; i++)
+    {
+      g_ptr_array_add (reports, new_layout (state, i, FALSE));
+      g_ptr_array_add (reports, new_layout (other_state, i, TRUE));
+    }
+
+  layouts = g_hash_table_new (cc_display_config_hash, cc_display_config_equal);
+
+  start_time = g_get_monotonic_time ();
+  for (i = 0; i < HASH_N_REPORTS; i++)
+    g_hash_table_add (layouts, g_ptr_array_index (reports, i % reports->len));
+  duration_us = g_get_monotonic_time () - start_time;
+
+  g_test_minimized_result (duration_us * 1000.0 / HASH_N_REPORTS,
+                           "%.0f ns per deduplicated configuration",
+                           duration_us * 1000.0 / HASH_N_REPORTS);
+  g_assert_cmpuint (g_hash_table_size (layouts), ==, HASH_N_LAYOUTS);
+}
+
+/* States differing only in the serial all describe the same layout */
+static void
+test_state_hash (void)
+{
+  g_autoptr(GPtrArray) states = NULL;
+  g_autoptr(GHashTable) layouts = NULL;
+  int64_t start_time, duration_us;
+  unsigned int i;
+
+  states = g_ptr_array_new_with_free_func ((GDestroyNotify) cc_display_state_free);
+  for (i = 0; i < HASH_N_STATES; i++)
+    g_ptr_array_add (states, new_state (i + 1));
+
+  layouts = g_hash_table_new (cc_display_state_hash, cc_display_state_equal);
+
+  start_time = g_get_monotonic_time ();
+  for (i = 0; i < HASH_N_REPORTS; i++)
+    g_hash_table_add (layouts, g_ptr_array_index (states, i % states->len));
+  duration_us = g_get_monotonic_time () - start_time;
+
+  g_test_minimized_result (duration_us * 1000.0 / HASH_N_REPORTS,
+                           "%.0f ns per deduplicated state",
+                           duration_us * 1000.0 / HASH_N_REPORTS);
+  g_assert_cmpuint (g_hash_table_size (layouts), ==, 1);
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/benchmark/hash/config", test_config_hash);
+  g_test_add_func ("/benchmark/hash/state", test_state_hash);
+
+  return g_test_run ();
+}
@@ -0,0 +1,303 @@
+/*
+ * Copyright (C) 2026  The gnome-monitor-config authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include "gmc-mock-display-config.h"
+
+#include "gmc-display-config.h"
+
+#define DISPLAY_CONFIG_BUS_NAME "org.gnome.Mutter.DisplayConfig"
+#define DISPLAY_CONFIG_OBJECT_PATH "/org/gnome/Mutter/DisplayConfig"
+
+/* Replies of org.freedesktop.DBus.RequestName */
+#define DBUS_NAME_FLAG_DO_NOT_QUEUE 4
+#define DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER 1
+
+struct _CcMockDisplayConfig
+{
+  char *address;
+  GThread *thread;
+  GMainContext *context;
+  GMainLoop *loop;
+
+  GMutex mutex;
+  GCond cond;
+  gboolean started;
+  GError *start_error;
+
+  /* Only used in the mock thread */
+  unsigned int serial;
+
+  int n_applied;
+};
+
+GVariant *
+cc_mock_display_config_new_state_variant (unsigned int serial)
+{
+  return g_variant_ref_sink (g_variant_new_parsed (
+    "(%u,"
+    " [(('eDP-1', 'BOE', '0x0bca', '0x00000000'),"
+    "   [('2560x1600@165.000', 2560, 1600, 165.0, 2.0,"
+    "     [1.0, 1.25, 1.5, 1.75, 2.0],"
+    "     {'is-current': <true>, 'is-preferred': <true>}),"
+    "    ('2560x1600@60.000', 2560, 1600, 60.0, 2.0,"
+    "     [1.0, 1.25, 1.5, 1.75, 2.0], @a{sv} {}),"
+    "    ('1920x1200@60.000', 1920, 1200, 60.0, 1.5,"
+    "     [1.0, 1.25, 1.5], @a{sv} {})],"
+    "   {'is-builtin': <true>, 'display-name': <'Built-in display'>}),"
+    "  (('DP-1', 'DEL', 'DELL U2723QE', '5KC0HK3'),"
+    "   [('3840x2160@60.000', 3840, 2160, 60.0, 1.5,"
+    "     [1.0, 1.25, 1.5, 1.75, 2.0],"
+    "     {'is-current': <true>, 'is-preferred': <true>}),"
+    "    ('3840x2160@30.000', 3840, 2160, 30.0, 1.5,"
+    "     [1.0, 1.25, 1.5, 1.75, 2.0], @a{sv} {}),"
+    "    ('2560x1440@59.951', 2560, 1440, 59.951, 1.0,"
+    "     [1.0, 1.25, 1.5], @a{sv} {}),"
+    "    ('1920x1080@60.000', 1920, 1080, 60.0, 1.0,"
+    "     [1.0, 1.25], @a{sv} {}),"
+    "    ('1920x1080@50.000', 1920, 1080, 50.0, 1.0,"
+    "     [1.0, 1.25], {'is-interlaced': <true>})],"
+    "   {'is-builtin': <false>, 'display-name': <'Dell Inc. 27'>})],"
+    " [(0, 0, 2.0, uint32 0, false,"
+    "   [('eDP-1', 'BOE', '0x0bca', '0x00000000')], @a{sv} {}),"
+    "  (1280, 0, 1.5, uint32 0, true,"
+    "   [('DP-1', 'DEL', 'DELL U2723QE', '5KC0HK3')], @a{sv} {})],"
+    " {'layout-mode': <uint32 1>,"
+    "  'supports-changing-layout-mode': <false>,"
+    "  'max-screen-size': <(16384, 16384)>})",
+    serial));
+}
+
+static gboolean
+on_handle_get_current_state (CcDbusDisplayConfig *skeleton,
+                             GDBusMethodInvocation *invocation,
+                             gpointer user_data)
+{
+  CcMockDisplayConfig *mock = user_data;
+  g_autoptr(GVariant) state_variant = NULL;
+
+  state_variant = cc_mock_display_config_new_state_variant (mock->serial);
+  g_dbus_method_invocation_return_value (invocation, state_variant);
+
+  return TRUE;
+}
+
+static gboolean
+on_handle_apply_monitors_config (CcDbusDisplayConfig *skeleton,
+                                 GDBusMethodInvocation *invocation,
+                                 unsigned int serial,
+                                 unsigned int method,
+                                 GVariant *logical_monitor_configs_variant,
+                                 GVariant *properties_variant,
+                                 gpointer user_data)
+{
+  CcMockDisplayConfig *mock = user_data;
+
+  if (serial != mock->serial)
+    {
+      g_dbus_method_invocation_return_error (invocation,
+                                             G_DBUS_ERROR,
+                                             G_DBUS_ERROR_ACCESS_DENIED,
+                                             "The requested configuration is "
+                                             "based on stale information");
+      return TRUE;
+    }
+
+  if (g_variant_n_children (logical_monitor_configs_variant) == 0)
+    {
+      g_dbus_method_invocation_return_error (invocation,
+                                             G_DBUS_ERROR,
+                                             G_DBUS_ERROR_INVALID_ARGS,
+                                             "No logical monitors");
+      return TRUE;
+    }
+
+  if (method != CC_DISPLAY_METHOD_VERIFY)
+    {
+      mock->serial++;
+      g_atomic_int_inc (&mock->n_applied);
+    }
+
+  cc_dbus_display_config_complete_apply_monitors_config (skeleton, invocation);
+
+  if (method != CC_DISPLAY_METHOD_VERIFY)
+    cc_dbus_display_config_emit_monitors_changed (skeleton);
+
+  return TRUE;
+}
+
+static gboolean
+request_name (GDBusConnection *connection,
+              GError **error)
+{
+  g_autoptr(GVariant) reply = NULL;
+  unsigned int result;
+
+  reply = g_dbus_connection_call_sync (connection,
+                                       "org.freedesktop.DBus",
+                                       "/org/freedesktop/DBus",
+                                       "org.freedesktop.DBus",
+                                       "RequestName",
+                                       g_variant_new ("(su)",
+                                                      DISPLAY_CONFIG_BUS_NAME,
+                                                      DBUS_NAME_FLAG_DO_NOT_QUEUE),
+                                       G_VARIANT_TYPE ("(u)"),
+                                       G_DBUS_CALL_FLAGS_NONE,
+                                       -1, NULL, error);
+  if (!reply)
+    return FALSE;
+
+  g_variant_get (reply, "(u)", &result);
+  if (result != DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_EXISTS,
+                   "%s is already owned", DISPLAY_CONFIG_BUS_NAME);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+export_display_config (CcMockDisplayConfig *mock,
+                       GDBusConnection **connection,
+                       CcDbusDisplayConfig **skeleton,
+                       GError **error)
+{
+  *connection =
+    g_dbus_connection_new_for_address_sync (mock->address,
+                                            (G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+                                             G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION),
+                                            NULL, NULL, error);
+  if (!*connection)
+    return FALSE;
+
+  *skeleton = cc_dbus_display_config_skeleton_new ();
+  g_signal_connect (*skeleton, "handle-get-current-state",
+                    G_CALLBACK (on_handle_get_current_state), mock);
+  g_signal_connect (*skeleton, "handle-apply-monitors-config",
+                    G_CALLBACK (on_handle_apply_monitors_config), mock);
+
+  if (!g_dbus_interface_skeleton_export (G_DBUS_INTERFACE_SKELETON (*skeleton),
+                                         *connection,
+                                         DISPLAY_CONFIG_OBJECT_PATH,
+                                         error))
+    return FALSE;
+
+  return request_name (*connection, error);
+}
+
+/*
+ * Method calls are dispatched in the thread-default context of the thread
+ * exporting the object, so everything D-Bus happens in the mock thread.
+ */
+static gpointer
+run_mock (gpointer user_data)
+{
+  CcMockDisplayConfig *mock = user_data;
+  g_autoptr(GDBusConnection) connection = NULL;
+  g_autoptr(CcDbusDisplayConfig) skeleton = NULL;
+  GError *error = NULL;
+  gboolean exported;
+
+  g_main_context_push_thread_default (mock->context);
+
+  exported = export_display_config (mock, &connection, &skeleton, &error);
+
+  g_mutex_lock (&mock->mutex);
+  mock->started = TRUE;
+  mock->start_error = error;
+  g_cond_signal (&mock->cond);
+  g_mutex_unlock (&mock->mutex);
+
+  if (exported)
+    g_main_loop_run (mock->loop);
+
+  if (skeleton &&
+      g_dbus_interface_skeleton_get_connection (G_DBUS_INTERFACE_SKELETON (skeleton)))
+    g_dbus_interface_skeleton_unexport (G_DBUS_INTERFACE_SKELETON (skeleton));
+  if (connection)
+    g_dbus_connection_flush_sync (connection, NULL, NULL);
+
+  g_main_context_pop_thread_default (mock->context);
+
+  return NULL;
+}
+
+CcMockDisplayConfig *
+cc_mock_display_config_new (const char *address,
+                            GError **error)
+{
+  g_autoptr(CcMockDisplayConfig) mock = NULL;
+
+  mock = g_new0 (CcMockDisplayConfig, 1);
+  mock->address = g_strdup (address);
+  mock->context = g_main_context_new ();
+  mock->loop = g_main_loop_new (mock->context, FALSE);
+  mock->serial = 1;
+  g_mutex_init (&mock->mutex);
+  g_cond_init (&mock->cond);
+
+  mock->thread = g_thread_new ("mock-display-config", run_mock, mock);
+
+  g_mutex_lock (&mock->mutex);
+  while (!mock->started)
+    g_cond_wait (&mock->cond, &mock->mutex);
+  g_mutex_unlock (&mock->mutex);
+
+  if (mock->start_error)
+    {
+      g_propagate_error (error, g_steal_pointer (&mock->start_error));
+      return NULL;
+    }
+
+  return g_steal_pointer (&mock);
+}
+
+static gboolean
+quit_mock (gpointer user_data)
+{
+  CcMockDisplayConfig *mock = user_data;
+
+  g_main_loop_quit (mock->loop);
+
+  return G_SOURCE_REMOVE;
+}
+
+void
+cc_mock_display_config_free (CcMockDisplayConfig *mock)
+{
+  /* Quitting from an idle, as the loop might not run yet */
+  g_main_context_invoke (mock->context, quit_mock, mock);
+  g_thread_join (mock->thread);
+
+  g_clear_error (&mock->start_error);
+  g_main_loop_unref (mock->loop);
+  g_main_context_unref (mock->context);
+  g_mutex_clear (&mock->mutex);
+  g_cond_clear (&mock->cond);
+  g_free (mock->address);
+  g_free (mock);
+}
+
+unsigned int
+cc_mock_display_config_get_n_applied (CcMockDisplayConfig *mock)
+{
+  return g_atomic_int_get (&mock->n_applied);
+}
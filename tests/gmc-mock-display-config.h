@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2026  The gnome-monitor-config authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#ifndef _CC_MOCK_DISPLAY_CONFIG_H
+#define _CC_MOCK_DISPLAY_CONFIG_H
+
+#include <gio/gio.h>
+
+/*
+ * A stand-in for the org.gnome.Mutter.DisplayConfig service of the
+ * compositor, running in a thread of its own on the bus at a given address,
+ * typically the one of a GTestDBus.
+ *
+ * It reports a laptop with a built-in panel and an external monitor.
+ * ApplyMonitorsConfig checks the serial and, unless only verifying, bumps it
+ * and emits MonitorsChanged like Mutter does, but keeps the monitors as they
+ * are.
+ */
+typedef struct _CcMockDisplayConfig CcMockDisplayConfig;
+
+CcMockDisplayConfig * cc_mock_display_config_new (const char *address,
+                                                  GError **error);
+void cc_mock_display_config_free (CcMockDisplayConfig *mock);
+
+unsigned int cc_mock_display_config_get_n_applied (CcMockDisplayConfig *mock);
+
+/* The GetCurrentState reply the mock sends with @serial */
+GVariant * cc_mock_display_config_new_state_variant (unsigned int serial);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (CcMockDisplayConfig, cc_mock_display_config_free)
+
+#endif /* _CC_MOCK_DISPLAY_CONFIG_H */
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2026  The gnome-monitor-config authors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ */
+
+
+#include <gio/gio.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include "gmc-display-config-manager.h"
+#include "gmc-mock-display-config.h"
+
+#define SOAK_N_WARMUP_CYCLES 1000
+#define SOAK_N_CYCLES 100000
+
+/*
+ * Room for allocator noise; leaking as little as 16 bytes per cycle already
+ * exceeds it.
+ */
+#define SOAK_MAX_RSS_GROWTH (1024 * 1024)
+
+static size_t
+get_rss (void)
+{
+  g_autofree char *contents = NULL;
+  unsigned long size, resident;
+
+  g_assert_true (g_file_get_contents ("/proc/self/statm", &contents,
+                                      NULL, NULL));
+  g_assert_cmpint (sscanf (contents, "%lu %lu", &size, &resident), ==, 2);
+
+  return resident * sysconf (_SC_PAGESIZE);
+}
+
+/* Builds a configuration that keeps the logical monitors of @state as they are */
+static CcDisplayConfig *
+config_from_state (CcDisplayState *state)
+{
+  CcDisplayConfig *config;
+  GList *l;
+
+  config = cc_display_config_new ();
+  for (l = cc_display_state_get_logical_monitors (state); l; l = l->next)
+    {
+      CcDisplayLogicalMonitor *logical_monitor = l->data;
+      CcDisplayLogicalMonitorConfig *logical_monitor_config;
+      cairo_rectangle_int_t layout;
+      GList *k;
+
+      cc_display_logical_monitor_calculate_layout (logical_monitor, &layout);
+
+      logical_monitor_config = cc_display_logical_monitor_config_new ();
+      cc_display_logical_monitor_config_set_position (logical_monitor_config,
+                                                      layout.x, layout.y);
+      cc_display_logical_monitor_config_set_scale (logical_monitor_config,
+                                                   cc_display_logical_monitor_get_scale (logical_monitor));
+      cc_display_logical_monitor_config_set_transform (logical_monitor_config,
+                                                       cc_display_logical_monitor_get_transform (logical_monitor));
+      cc_display_logical_monitor_config_set_is_primary (logical_monitor_config,
+                                                        cc_display_logical_monitor_is_primary (logical_monitor));
+
+      for (k = cc_display_logical_monitor_get_monitors (logical_monitor);
+           k;
+           k = k->next)
+        {
+          CcDisplayMonitor *monitor = k->data;
+
+          cc_display_logical_monitor_config_add_monitor (logical_monitor_config,
+                                                         monitor,
+                                                         cc_display_monitor_get_current_mode (monitor));
+        }
+
+      cc_display_config_add_logical_monitor (config, logical_monitor_config);
+    }
+
+  return config;
+}
+
+static void
+run_cycle (CcDisplayConfigManager *manager)
+{
+  g_autoptr(CcDisplayState) state = NULL;
+  g_autoptr(CcDisplayConfig) config = NULL;
+  g_autoptr(GError) error = NULL;
+  gboolean applied;
+
+  state = cc_display_config_manager_new_current_state (manager, &error);
+  g_assert_no_error (error);
+
+  config = config_from_state (state);
+  applied = cc_display_config_manager_apply (manager, state, config,
+                                             CC_DISPLAY_METHOD_TEMPORARY,
+                                             &error);
+  g_assert_no_error (error);
+  g_assert_true (applied);
+
+  /* Handle the MonitorsChanged signals like a long running process would */
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
+}
+
+static void
+test_soak_fetch_apply (void)
+{
+  g_autoptr(GTestDBus) bus = NULL;
+  g_autoptr(CcMockDisplayConfig) mock = NULL;
+  g_autoptr(CcDisplayConfigManager) manager = NULL;
+  g_autoptr(GError) error = NULL;
+  size_t warm_rss, final_rss;
+  unsigned int i;
+
+  bus = g_test_dbus_new (G_TEST_DBUS_NONE);
+  g_test_dbus_up (bus);
+
+  mock = cc_mock_display_config_new (g_test_dbus_get_bus_address (bus),
+                                     &error);
+  g_assert_no_error (error);
+
+  /* The bus set itself up as the session bus */
+  manager = cc_display_config_manager_new (&error);
+  g_assert_no_error (error);
+
+  /* Let caches and allocator arenas reach their working size first */
+  for (i = 0; i < SOAK_N_WARMUP_CYCLES; i++)
+    run_cycle (manager);
+  warm_rss = get_rss ();
+
+  for (i = 0; i < SOAK_N_CYCLES; i++)
+    run_cycle (manager);
+  final_rss = get_rss ();
+
+  g_test_message ("RSS %zu KiB after warm-up, %zu KiB after %u cycles",
+                  warm_rss / 1024, final_rss / 1024, SOAK_N_CYCLES);
+  g_assert_cmpuint (final_rss, <=, warm_rss + SOAK_MAX_RSS_GROWTH);
+  g_assert_cmpuint (cc_mock_display_config_get_n_applied (mock), ==,
+                    SOAK_N_WARMUP_CYCLES + SOAK_N_CYCLES);
+
+  g_clear_object (&manager);
+  g_clear_pointer (&mock, cc_mock_display_config_free);
+  g_test_dbus_down (bus);
+}
+
+int
+main (int argc,
+      char *argv[])
+{
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/soak/fetch-apply", test_soak_fetch_apply);
+
+  return g_test_run ();
+}